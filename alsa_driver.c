@@ -0,0 +1,280 @@
+#include "alsa_driver.h"
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rt_log.h"
+#include "rt_stats.h"
+
+// ============================================================================
+// ALSA DRIVER TYPES
+// ============================================================================
+
+#define ALSA_WAIT_TIMEOUT_MS 1000
+
+typedef struct {
+    snd_pcm_t *pcm;
+    audio_format_t format;
+    audio_callback_t callback;
+    void *user_data;
+    atomic_bool playing;
+    snd_pcm_uframes_t period_size; // As granted by the device
+    snd_pcm_uframes_t buffer_size;
+} alsa_audio_context_t;
+
+enum {
+    ALSA_ERROR_NONE,
+    ALSA_ERROR_ALLOC,
+    ALSA_ERROR_FORMAT,
+    ALSA_ERROR_OPEN,
+    ALSA_ERROR_HW_PARAMS,
+    ALSA_ERROR_SW_PARAMS,
+};
+
+// ============================================================================
+// ALSA DRIVER GLOBAL STATE
+// ============================================================================
+
+static volatile sig_atomic_t interrupted = 0;
+static const char *config_device = ALSA_DEFAULT_DEVICE;
+static uint32_t config_period_frames = ALSA_DEFAULT_PERIOD_FRAMES;
+static uint32_t config_periods = ALSA_DEFAULT_PERIODS;
+
+static void signal_handler(int sig) {
+    (void)sig;  // Unused parameter
+    interrupted = 1;
+}
+
+void alsa_driver_setup_signals(void) {
+    signal(SIGINT, signal_handler);
+}
+
+void alsa_driver_configure(const char *device, uint32_t period_frames, uint32_t periods) {
+    config_device = device ? device : ALSA_DEFAULT_DEVICE;
+    config_period_frames = period_frames ? period_frames : ALSA_DEFAULT_PERIOD_FRAMES;
+    config_periods = periods >= 2 ? periods : ALSA_DEFAULT_PERIODS;
+}
+
+// ============================================================================
+// DEVICE SETUP
+// ============================================================================
+
+static snd_pcm_format_t to_alsa_format(audio_sample_format_t format) {
+    switch (format) {
+        case AUDIO_FORMAT_S32: return SND_PCM_FORMAT_S32;
+        case AUDIO_FORMAT_F32: return SND_PCM_FORMAT_FLOAT;
+        default: return SND_PCM_FORMAT_S16;
+    }
+}
+
+// Interleaved mmap access in exactly our format, with the configured period layout. A fixed rate
+// is resampled by alsa-lib if the hardware lacks it; AUDIO_RATE_NATIVE takes a hardware rate as is.
+static int set_hw_params(alsa_audio_context_t *ctx) {
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_hw_params_alloca(&hw);
+
+    bool native = ctx->format.sample_rate == AUDIO_RATE_NATIVE;
+    unsigned int rate = native ? ALSA_PREFERRED_RATE : ctx->format.sample_rate;
+    snd_pcm_uframes_t period = config_period_frames;
+    snd_pcm_uframes_t buffer = (snd_pcm_uframes_t)config_period_frames * config_periods;
+
+    if (snd_pcm_hw_params_any(ctx->pcm, hw) < 0 ||
+        snd_pcm_hw_params_set_access(ctx->pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED) < 0 ||
+        snd_pcm_hw_params_set_format(ctx->pcm, hw, to_alsa_format(ctx->format.format)) < 0 ||
+        snd_pcm_hw_params_set_channels(ctx->pcm, hw, ctx->format.channels) < 0 ||
+        snd_pcm_hw_params_set_rate_resample(ctx->pcm, hw, native ? 0 : 1) < 0 ||
+        (native ? snd_pcm_hw_params_set_rate_near(ctx->pcm, hw, &rate, NULL)
+                : snd_pcm_hw_params_set_rate(ctx->pcm, hw, rate, 0)) < 0 ||
+        snd_pcm_hw_params_set_period_size_near(ctx->pcm, hw, &period, NULL) < 0 ||
+        snd_pcm_hw_params_set_buffer_size_near(ctx->pcm, hw, &buffer) < 0 ||
+        snd_pcm_hw_params(ctx->pcm, hw) < 0) {
+        return -1;
+    }
+
+    snd_pcm_hw_params_get_period_size(hw, &ctx->period_size, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, &ctx->buffer_size);
+    ctx->format.sample_rate = rate;
+    return 0;
+}
+
+// Wake once a whole period is free, and start as soon as the buffer has been primed
+static int set_sw_params(alsa_audio_context_t *ctx) {
+    snd_pcm_sw_params_t *sw;
+    snd_pcm_sw_params_alloca(&sw);
+
+    snd_pcm_uframes_t start = ctx->buffer_size / ctx->period_size * ctx->period_size;
+    if (snd_pcm_sw_params_current(ctx->pcm, sw) < 0 ||
+        snd_pcm_sw_params_set_start_threshold(ctx->pcm, sw, start) < 0 ||
+        snd_pcm_sw_params_set_avail_min(ctx->pcm, sw, ctx->period_size) < 0 ||
+        snd_pcm_sw_params(ctx->pcm, sw) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Underrun or suspend: count it and re-prepare the device, returns false if that fails
+static bool recover(alsa_audio_context_t *ctx, int err) {
+    if (err == -EPIPE) {
+        RT_STATS_UNDERRUN();
+    }
+    return snd_pcm_recover(ctx->pcm, err, 1) >= 0;
+}
+
+// ============================================================================
+// ALSA DRIVER IMPLEMENTATION
+// ============================================================================
+
+void alsa_driver_run(void *context) {
+    alsa_audio_context_t *ctx = context;
+
+    while (atomic_load_explicit(&ctx->playing, memory_order_acquire) && ctx->callback && !interrupted) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(ctx->pcm);
+        if (avail < 0) {
+            if (!recover(ctx, (int)avail)) {
+                break;
+            }
+            continue;
+        }
+
+        if ((snd_pcm_uframes_t)avail < ctx->period_size) {
+            rt_log_drain(); // Print while the device still has whole periods queued
+            int err = snd_pcm_wait(ctx->pcm, ALSA_WAIT_TIMEOUT_MS);
+            if (err < 0 && err != -EINTR && !recover(ctx, err)) {
+                break;
+            }
+            continue;
+        }
+
+        // Render the period straight into the device's ring (fewer frames where it wraps)
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t frames = ctx->period_size;
+        int err = snd_pcm_mmap_begin(ctx->pcm, &areas, &offset, &frames);
+        if (err < 0) {
+            if (!recover(ctx, err)) {
+                break;
+            }
+            continue;
+        }
+
+        // Interleaved: every channel shares one area, the first one points at channel 0
+        uint8_t *samples = (uint8_t *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+        uint64_t render_start = RT_STATS_NOW();
+        bool continue_playing = ctx->callback(samples, frames, &ctx->format, ctx->user_data);
+        RT_STATS_QUANTUM((uint32_t)frames, ctx->format.sample_rate, RT_STATS_NOW() - render_start);
+
+        // Only errors go through recovery: a short commit is not an underrun, its remaining
+        // frames are just dropped and the next period starts where the device stopped
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(ctx->pcm, offset, frames);
+        if (committed < 0 && !recover(ctx, (int)committed)) {
+            break;
+        }
+
+        if (!continue_playing) {
+            atomic_store_explicit(&ctx->playing, false, memory_order_release);
+            ctx->user_data = NULL;  // Callback finished the song
+            snd_pcm_drain(ctx->pcm); // Let the queued periods play out
+        }
+    }
+}
+
+static void* alsa_init(const audio_format_t *format, audio_callback_t callback, int *error) {
+    if (format->channels < 1 || format->channels > AUDIO_MAX_CHANNELS) {
+        *error = ALSA_ERROR_FORMAT;
+        return NULL;
+    }
+
+    alsa_audio_context_t *ctx = calloc(1, sizeof(alsa_audio_context_t));
+    if (!ctx) {
+        *error = ALSA_ERROR_ALLOC;
+        return NULL;
+    }
+
+    ctx->format = *format;
+    ctx->callback = callback;
+    atomic_init(&ctx->playing, false);
+
+    if (snd_pcm_open(&ctx->pcm, config_device, SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+        free(ctx);
+        *error = ALSA_ERROR_OPEN;
+        return NULL;
+    }
+    if (set_hw_params(ctx) < 0) {
+        snd_pcm_close(ctx->pcm);
+        free(ctx);
+        *error = ALSA_ERROR_HW_PARAMS;
+        return NULL;
+    }
+    if (set_sw_params(ctx) < 0) {
+        snd_pcm_close(ctx->pcm);
+        free(ctx);
+        *error = ALSA_ERROR_SW_PARAMS;
+        return NULL;
+    }
+
+    printf("ALSA %s: %u Hz, period %lu frames, buffer %lu frames\n", config_device, ctx->format.sample_rate,
+           (unsigned long)ctx->period_size, (unsigned long)ctx->buffer_size);
+    *error = ALSA_ERROR_NONE;
+    return ctx;
+}
+
+static void alsa_play(void *context, void *user_data) {
+    alsa_audio_context_t *ctx = context;
+    ctx->user_data = user_data;
+    atomic_store_explicit(&ctx->playing, true, memory_order_release);
+    printf("Started playback\n");
+}
+
+static void alsa_stop(void *context) {
+    alsa_audio_context_t *ctx = context;
+    atomic_store_explicit(&ctx->playing, false, memory_order_release);
+    printf("Stopped playback\n");
+}
+
+static void alsa_resume(void *context) {
+    alsa_audio_context_t *ctx = context;
+    if (ctx->user_data) {
+        atomic_store_explicit(&ctx->playing, true, memory_order_release);
+        printf("Resumed playback\n");
+    }
+}
+
+static void alsa_cleanup(void *context) {
+    alsa_audio_context_t *ctx = context;
+
+    if (ctx->pcm) {
+        snd_pcm_drop(ctx->pcm);
+        snd_pcm_close(ctx->pcm);
+    }
+    free(ctx);
+}
+
+static const audio_format_t* alsa_format(void *context) {
+    alsa_audio_context_t *ctx = context;
+    return &ctx->format;
+}
+
+static const char* alsa_strerror(int error_code) {
+    switch (error_code) {
+        case ALSA_ERROR_NONE: return "Success";
+        case ALSA_ERROR_ALLOC: return "Memory allocation failed";
+        case ALSA_ERROR_FORMAT: return "Unsupported channel count";
+        case ALSA_ERROR_OPEN: return "Cannot open PCM device";
+        case ALSA_ERROR_HW_PARAMS: return "Device does not support mmap access in the requested format";
+        case ALSA_ERROR_SW_PARAMS: return "Cannot set software parameters";
+        default: return "Unknown error";
+    }
+}
+
+// ALSA driver vtable
+const audio_driver_t alsa_driver = {
+    .init = alsa_init,
+    .play = alsa_play,
+    .stop = alsa_stop,
+    .resume = alsa_resume,
+    .cleanup = alsa_cleanup,
+    .strerror = alsa_strerror,
+    .format = alsa_format
+};
@@ -0,0 +1,26 @@
+#ifndef ALSA_DRIVER_H
+#define ALSA_DRIVER_H
+
+#include <stdint.h>
+#include "audio_driver.h"
+
+// Direct ALSA implementation of audio_driver_t for hosts without a sound server:
+// renders each period straight into the device's mmap area
+// (snd_pcm_mmap_begin/commit) and recovers from xruns in place.
+extern const audio_driver_t alsa_driver;
+
+#define ALSA_DEFAULT_DEVICE "default"
+#define ALSA_DEFAULT_PERIOD_FRAMES 256
+#define ALSA_DEFAULT_PERIODS 3
+#define ALSA_PREFERRED_RATE 48000 // AUDIO_RATE_NATIVE takes the hardware rate nearest to this
+
+// Device and period layout used by the next init (call before init; NULL/0 keep the defaults)
+void alsa_driver_configure(const char *device, uint32_t period_frames, uint32_t periods);
+
+// Setup signal handling for clean shutdown (call from main)
+void alsa_driver_setup_signals(void);
+
+// Feed the device until the callback finishes the song, stop() is called or interrupted
+void alsa_driver_run(void *context);
+
+#endif // ALSA_DRIVER_H
@@ -1,4 +1,6 @@
 #include "array.h"
+#include <stdalign.h>
+#include <string.h>
 
 // ============================================================================
 // DYNAMIC ARRAY SYSTEM IMPLEMENTATION
@@ -29,11 +31,114 @@
  * - Memory efficient (array of structs, not pointers)
  * - Cache-friendly memory layout
  * - Embedded-friendly (shrink_to_fit for memory optimization)
+ *
+ * Arena-backed arrays (type_name##_array_init_arena) take their storage from an arena_t
+ * instead of the heap: array_free becomes a no-op and the whole arena is released at once.
  */
 
 // Constants that might be useful for array implementations
 const int ARRAY_DEFAULT_CAPACITY = 16; // Initial capacity for new arrays
 const int ARRAY_MAX_CAPACITY = 1048576; // 1M elements max (safety limit)
 
+// ============================================================================
+// ARENA ALLOCATOR
+// ============================================================================
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct arena_block {
+    arena_block_t* prev;
+    size_t size; // Usable bytes in data
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+static size_t align_up(size_t size) { return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1); }
+
+void arena_init(arena_t* arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->last = NULL;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    arena_block_t* block = arena->head;
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->prev = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+    }
+
+    void* ptr = block->data + block->used;
+    block->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+void* arena_realloc(arena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return arena_alloc(arena, new_size);
+    }
+
+    // The most recent allocation can be resized in place while it fits its block
+    arena_block_t* block = arena->head;
+    if (ptr == arena->last) {
+        size_t offset = (size_t)((unsigned char*)ptr - block->data);
+        size_t size = align_up(new_size ? new_size : 1);
+        if (size <= block->size - offset) {
+            block->used = offset + size;
+            return ptr;
+        }
+    }
+
+    if (new_size <= old_size) {
+        return ptr; // Shrinking elsewhere just leaves the tail unused
+    }
+
+    void* new_ptr = arena_alloc(arena, new_size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+void arena_reset(arena_t* arena) {
+    arena_block_t* block = arena->head;
+    if (!block) {
+        return;
+    }
+
+    arena_block_t* prev = block->prev;
+    while (prev) {
+        arena_block_t* next = prev->prev;
+        free(prev);
+        prev = next;
+    }
+
+    block->prev = NULL;
+    block->used = 0;
+    arena->last = NULL;
+}
+
+void arena_free(arena_t* arena) {
+    arena_block_t* block = arena->head;
+    while (block) {
+        arena_block_t* prev = block->prev;
+        free(block);
+        block = prev;
+    }
+
+    arena->head = NULL;
+    arena->last = NULL;
+}
+
 // Future: Common utility functions could go here
 // For example: array_copy, array_sort, array_search, etc.
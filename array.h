@@ -1,8 +1,32 @@
 #ifndef ARRAY_H
 #define ARRAY_H
 
+#include <limits.h>
+#include <stddef.h>
 #include <stdlib.h>
 
+// ============================================================================
+// ARENA ALLOCATOR
+// ============================================================================
+
+typedef struct arena_block arena_block_t;
+
+// Bump allocator over a chain of large blocks, released all at once. Used for the parse and
+// sequence phases so a score costs a handful of mallocs instead of one per chord and regrowth.
+typedef struct {
+    arena_block_t* head; // Block currently allocated from
+    size_t block_size; // Minimum size of each new block
+    void* last; // Most recent allocation, can be grown or shrunk in place
+} arena_t;
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+void arena_init(arena_t* arena, size_t block_size); // Allocates nothing until first use
+void* arena_alloc(arena_t* arena, size_t size); // Aligned for any type, NULL if out of memory
+void* arena_realloc(arena_t* arena, void* ptr, size_t old_size, size_t new_size);
+void arena_reset(arena_t* arena); // Drop all allocations, keep the newest block for reuse
+void arena_free(arena_t* arena);
+
 // ============================================================================
 // DYNAMIC ARRAY SYSTEM
 // ============================================================================
@@ -13,9 +37,12 @@
         element_type* data;                                                                                            \
         int count;                                                                                                     \
         int capacity;                                                                                                  \
+        arena_t* arena; /* Storage owner, NULL for heap-allocated data */                                              \
     } type_name##_array_t;                                                                                             \
                                                                                                                        \
     void type_name##_array_init(type_name##_array_t* arr);                                                             \
+    void type_name##_array_init_arena(type_name##_array_t* arr, arena_t* arena);                                       \
+    int type_name##_array_reserve(type_name##_array_t* arr, int capacity);                                             \
     void type_name##_array_free(type_name##_array_t* arr);                                                             \
     int type_name##_array_push(type_name##_array_t* arr, element_type item);                                           \
     void type_name##_array_clear(type_name##_array_t* arr);                                                            \
@@ -27,22 +54,47 @@
         arr->data = NULL;                                                                                              \
         arr->count = 0;                                                                                                \
         arr->capacity = 0;                                                                                             \
+        arr->arena = NULL;                                                                                             \
+    }                                                                                                                  \
+                                                                                                                       \
+    void type_name##_array_init_arena(type_name##_array_t* arr, arena_t* arena) {                                      \
+        type_name##_array_init(arr);                                                                                   \
+        arr->arena = arena;                                                                                            \
     }                                                                                                                  \
                                                                                                                        \
     void type_name##_array_free(type_name##_array_t* arr) {                                                            \
-        free(arr->data);                                                                                               \
+        if (!arr->arena) {                                                                                             \
+            free(arr->data); /* Arena storage is released with the arena */                                            \
+        }                                                                                                              \
         arr->data = NULL;                                                                                              \
         arr->count = 0;                                                                                                \
         arr->capacity = 0;                                                                                             \
     }                                                                                                                  \
                                                                                                                        \
+    int type_name##_array_reserve(type_name##_array_t* arr, int capacity) {                                            \
+        if (capacity <= arr->capacity) {                                                                               \
+            return 1;                                                                                                  \
+        }                                                                                                              \
+        element_type* new_data;                                                                                        \
+        if (arr->arena) {                                                                                              \
+            new_data = arena_realloc(arr->arena, arr->data, arr->capacity * sizeof(element_type),                      \
+                                     capacity * sizeof(element_type));                                                 \
+        } else {                                                                                                       \
+            new_data = realloc(arr->data, capacity * sizeof(element_type));                                            \
+        }                                                                                                              \
+        if (!new_data)                                                                                                 \
+            return 0;                                                                                                  \
+        arr->data = new_data;                                                                                          \
+        arr->capacity = capacity;                                                                                      \
+        return 1;                                                                                                      \
+    }                                                                                                                  \
+                                                                                                                       \
     int type_name##_array_push(type_name##_array_t* arr, element_type item) {                                          \
         if (arr->count >= arr->capacity) {                                                                             \
-            arr->capacity = arr->capacity ? arr->capacity * 2 : 16;                                                    \
-            element_type* new_data = realloc(arr->data, arr->capacity * sizeof(element_type));                         \
-            if (!new_data)                                                                                             \
+            if (arr->capacity > INT_MAX / 2) /* The doubled capacity would overflow */                                 \
+                return 0;                                                                                              \
+            if (!type_name##_array_reserve(arr, arr->capacity ? arr->capacity * 2 : 16))                               \
                 return 0;                                                                                              \
-            arr->data = new_data;                                                                                      \
         }                                                                                                              \
         arr->data[arr->count++] = item;                                                                                \
         return 1;                                                                                                      \
@@ -59,7 +111,14 @@
             return 1; /* Already optimal */                                                                            \
         }                                                                                                              \
                                                                                                                        \
-        element_type* new_data = realloc(arr->data, arr->count * sizeof(element_type));                                \
+        element_type* new_data;                                                                                        \
+        if (arr->arena) {                                                                                              \
+            /* Only gives memory back when this array is the arena's last allocation */                                \
+            new_data = arena_realloc(arr->arena, arr->data, arr->capacity * sizeof(element_type),                      \
+                                     arr->count * sizeof(element_type));                                               \
+        } else {                                                                                                       \
+            new_data = realloc(arr->data, arr->count * sizeof(element_type));                                          \
+        }                                                                                                              \
         if (!new_data) {                                                                                               \
             return 0; /* Realloc failed, but original data is still valid */                                           \
         }                                                                                                              \
@@ -5,18 +5,43 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#define AUDIO_MAX_CHANNELS 8
+#define AUDIO_RATE_NATIVE 0 // sample_rate for init: run at the device's / graph's own rate, read back with format()
+
+typedef enum {
+    AUDIO_FORMAT_S16, // Signed 16-bit
+    AUDIO_FORMAT_S32, // Signed 32-bit
+    AUDIO_FORMAT_F32, // 32-bit float, full scale = [-1, 1]
+} audio_sample_format_t;
+
+// Interleaved output format, chosen at init and handed to every callback
+typedef struct {
+    uint32_t sample_rate;
+    uint32_t channels; // 1..AUDIO_MAX_CHANNELS
+    audio_sample_format_t format;
+} audio_format_t;
+
+// Bytes per interleaved frame
+static inline size_t audio_frame_size(const audio_format_t *format) {
+    return format->channels * (format->format == AUDIO_FORMAT_S16 ? sizeof(int16_t) : sizeof(int32_t));
+}
+
 // Audio callback function type - completely audio system agnostic
+// Fills num_frames interleaved frames of `format` into buffer.
 // Returns: true = continue playback, false = song finished
-typedef bool (*audio_callback_t)(int16_t *buffer, size_t num_samples, void *user_data);
+typedef bool (*audio_callback_t)(void *buffer, size_t num_frames, const audio_format_t *format, void *user_data);
 
 // Generic audio driver interface (vtable pattern)
 typedef struct {
-    void* (*init)(uint32_t sample_rate, audio_callback_t callback, int *error);
+    void* (*init)(const audio_format_t *format, audio_callback_t callback, int *error);
     void (*play)(void *context, void *user_data);
     void (*stop)(void *context);
     void (*resume)(void *context);
     void (*cleanup)(void *context);
     const char* (*strerror)(int error_code);
+    // Format the callback will be called with, once the backend has settled it (resolves
+    // AUDIO_RATE_NATIVE; may wait for negotiation). Call after init, before play. NULL on failure.
+    const audio_format_t* (*format)(void *context);
 } audio_driver_t;
 
-#endif // AUDIO_DRIVER_H
\ No newline at end of file
+#endif // AUDIO_DRIVER_H
@@ -0,0 +1,1100 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "multitrack.h"
+#include "oscillator.h"
+#include "parser.h"
+#include "score_cache.h"
+#include "score_file.h"
+#include "sequencer.h"
+
+// ============================================================================
+// BENCHMARK CONFIGURATION
+// ============================================================================
+
+#define BENCH_SAMPLE_RATE 44100
+#define BENCH_REPEATS 3 // Best-of-N for parse and sequence timings
+#define BENCH_QUANTUM 256 // Frames per sequencer_callback call
+#define MAX_RESULTS 96
+#define BENCH_TRACKS 4 // Tracks in the multi-track scaling run
+#define BENCH_CACHE_BUDGET (256u << 20) // Score cache budget, enough for a 1M-note score and two sequencings
+
+typedef enum {
+    STAGE_PARSE,
+    STAGE_SEQUENCE,
+    STAGE_RENDER,
+    STAGE_LOAD,
+} bench_stage_t;
+
+typedef struct {
+    bench_stage_t stage;
+    const char* name;
+    const char* kernel; // Render kernel or mode ("mt-wN", "stream", "mapped", "f32x2", "arena", "check",
+                        // "cached", "retuned", "culled")
+    long items; // Notes for parse/sequence, samples for render, events for load
+    double voice_samples; // Render only: sum of active voices over all samples
+    uint32_t voices_stolen; // Render only
+    uint32_t events_dropped; // Render only
+    double seconds;
+} bench_result_t;
+
+// Mono S16 unless a run says otherwise
+static const audio_format_t bench_format = {.sample_rate = BENCH_SAMPLE_RATE, .channels = 1, .format = AUDIO_FORMAT_S16};
+static const audio_format_t stereo_f32_format = {
+    .sample_rate = BENCH_SAMPLE_RATE, .channels = 2, .format = AUDIO_FORMAT_F32};
+
+static bench_result_t results[MAX_RESULTS];
+static int num_results = 0;
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void add_result(bench_result_t result) {
+    if (num_results < MAX_RESULTS) {
+        results[num_results++] = result;
+    }
+}
+
+// ============================================================================
+// SYNTHETIC SCORES
+// ============================================================================
+
+// Build a score by repeating tokens round-robin until `count` tokens have been written
+static char* generate_score(const char* prefix, const char* const* tokens, int num_tokens, long count) {
+    size_t max_token = 0;
+    for (int i = 0; i < num_tokens; i++) {
+        size_t len = strlen(tokens[i]);
+        if (len > max_token) {
+            max_token = len;
+        }
+    }
+
+    size_t prefix_len = strlen(prefix);
+    char* score = malloc(prefix_len + (size_t)count * (max_token + 1) + 1);
+    if (!score) {
+        return NULL;
+    }
+
+    char* p = score;
+    memcpy(p, prefix, prefix_len);
+    p += prefix_len;
+    for (long i = 0; i < count; i++) {
+        const char* token = tokens[i % num_tokens];
+        size_t len = strlen(token);
+        memcpy(p, token, len);
+        p += len;
+        *p++ = ' ';
+    }
+    *p = '\0';
+    return score;
+}
+
+// Single notes exercising accidentals, octaves, durations, dots, tuplets and rests
+static char* generate_melody(long num_notes) {
+    static const char* const tokens[] = {"c4", "d8", "e16", "fs", "g2", "af4.", "b8t", "c'", "d,4", "r4", "e''16", "bf,,"};
+    return generate_score("", tokens, sizeof(tokens) / sizeof(tokens[0]), num_notes);
+}
+
+// The same melody laid out like generated score files: one note per line, deeply indented
+static char* generate_indented_melody(long num_notes) {
+#define TABS "\n\t\t\t\t"
+#define SPACES "\n                "
+    static const char* const tokens[] = {"c4" TABS,  "d8" SPACES, "e16" TABS, "fs" SPACES, "g2" TABS,    "af4." SPACES,
+                                         "b8t" TABS, "c'" SPACES, "d,4" TABS, "r4" SPACES, "e''16" TABS, "bf,," SPACES};
+#undef TABS
+#undef SPACES
+    return generate_score("", tokens, sizeof(tokens) / sizeof(tokens[0]), num_notes);
+}
+
+// Melody notes spread over 16 {name} tracks, interleaved four notes at a time
+static char* generate_tracks(long num_notes) {
+    static const char* const tokens[] = {
+        "{t0} c4 d8 e16 fs",   "{t1} g2 af4. b8t c'",  "{t2} d,4 r4 e''16 bf,,", "{t3} c4 d8 e16 fs",
+        "{t4} g2 af4. b8t c'", "{t5} d,4 r4 e''16 bf,,", "{t6} c4 d8 e16 fs",   "{t7} g2 af4. b8t c'",
+        "{t8} d,4 r4 e''16 bf,,", "{t9} c4 d8 e16 fs", "{t10} g2 af4. b8t c'", "{t11} d,4 r4 e''16 bf,,",
+        "{t12} c4 d8 e16 fs",  "{t13} g2 af4. b8t c'", "{t14} d,4 r4 e''16 bf,,", "{} c4 d8 e16 fs"};
+    return generate_score("", tokens, sizeof(tokens) / sizeof(tokens[0]), num_notes / 4);
+}
+
+// Dense 8-note chords
+static char* generate_chords(long num_chords, const char* prefix, const char* duration) {
+    static const char* const chords[] = {"<c e g b d' f' a' c''>", "<d f a c' e' g' b' d''>", "<f a c' e' g' b' d'' f''>",
+                                         "<g, b, d f a c' e' g'>"};
+    const int num_chords_in_cycle = sizeof(chords) / sizeof(chords[0]);
+
+    // Attach the duration to each chord token
+    const char* tokens[sizeof(chords) / sizeof(chords[0])];
+    char storage[sizeof(chords) / sizeof(chords[0])][64];
+    for (int i = 0; i < num_chords_in_cycle; i++) {
+        snprintf(storage[i], sizeof(storage[i]), "%s%s", chords[i], duration);
+        tokens[i] = storage[i];
+    }
+    return generate_score(prefix, tokens, num_chords_in_cycle, num_chords);
+}
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+static note_array_t bench_parse(const char* name, const char* score) {
+    note_array_t best_notes = {0};
+    double best = 0.0;
+
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = monotonic_seconds();
+        note_array_t notes = parse_music(score);
+        double elapsed = monotonic_seconds() - start;
+
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+        if (r == 0) {
+            best_notes = notes;
+        } else {
+            free_note_array(&notes);
+        }
+    }
+
+    add_result((bench_result_t){.stage = STAGE_PARSE, .name = name, .items = best_notes.count, .seconds = best});
+    return best_notes;
+}
+
+// Validation only (parse_check): the pass a batch job runs before committing to a render
+static void bench_check(const char* name, const char* score, long num_notes) {
+    double best = 0.0;
+
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = monotonic_seconds();
+        int errors = parse_check(score, NULL, 0);
+        double elapsed = monotonic_seconds() - start;
+
+        if (errors != 0) {
+            fprintf(stderr, "%s: %d parse errors\n", name, errors);
+        }
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    add_result(
+        (bench_result_t){.stage = STAGE_PARSE, .name = name, .kernel = "check", .items = num_notes, .seconds = best});
+}
+
+static event_array_t bench_sequence(const char* name, const note_array_t* notes) {
+    event_array_t best_events = {0};
+    double best = 0.0;
+
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = monotonic_seconds();
+        event_array_t events =
+            sequence_events(notes, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.3f);
+        double elapsed = monotonic_seconds() - start;
+
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+        if (r == 0) {
+            best_events = events;
+        } else {
+            event_array_free(&events);
+        }
+    }
+
+    add_result((bench_result_t){.stage = STAGE_SEQUENCE, .name = name, .items = notes->count, .seconds = best});
+    return best_events;
+}
+
+// Parse and sequence into a fresh arena per repeat (arena setup and release included)
+static void bench_arena(const char* name, const char* score) {
+    double best_parse = 0.0, best_sequence = 0.0;
+    long num_notes = 0;
+
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        arena_t arena;
+        arena_init(&arena, 0);
+
+        double start = monotonic_seconds();
+        note_array_t notes = parse_music_arena(score, &arena);
+        double parsed = monotonic_seconds();
+        event_array_t events =
+            sequence_events_arena(&notes, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.3f, &arena);
+        (void)events;
+        arena_free(&arena);
+        double done = monotonic_seconds();
+
+        if (r == 0 || parsed - start < best_parse) {
+            best_parse = parsed - start;
+        }
+        if (r == 0 || done - parsed < best_sequence) {
+            best_sequence = done - parsed;
+        }
+        num_notes = notes.count;
+    }
+
+    add_result((bench_result_t){
+        .stage = STAGE_PARSE, .name = name, .kernel = "arena", .items = num_notes, .seconds = best_parse});
+    add_result((bench_result_t){
+        .stage = STAGE_SEQUENCE, .name = name, .kernel = "arena", .items = num_notes, .seconds = best_sequence});
+}
+
+// Sequence through a warm score cache: "cached" repeats the request (hash, confirm, copy), "retuned"
+// changes the transposition each time so only the parse is skipped
+static void bench_cached(const char* name, const char* score, long num_notes) {
+    score_cache_t* cache = score_cache_create(BENCH_CACHE_BUDGET);
+    if (!cache) {
+        return;
+    }
+    event_array_t warm =
+        score_cache_sequence(cache, score, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.3f);
+    event_array_free(&warm);
+
+    double best_hit = 0.0, best_retuned = 0.0;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = monotonic_seconds();
+        event_array_t events =
+            score_cache_sequence(cache, score, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.3f);
+        double hit = monotonic_seconds();
+        event_array_t retuned =
+            score_cache_sequence(cache, score, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament, r + 1, 0.3f);
+        double done = monotonic_seconds();
+        event_array_free(&events);
+        event_array_free(&retuned);
+
+        if (r == 0 || hit - start < best_hit) {
+            best_hit = hit - start;
+        }
+        if (r == 0 || done - hit < best_retuned) {
+            best_retuned = done - hit;
+        }
+    }
+    score_cache_destroy(cache);
+
+    add_result((bench_result_t){
+        .stage = STAGE_SEQUENCE, .name = name, .kernel = "cached", .items = num_notes, .seconds = best_hit});
+    add_result((bench_result_t){
+        .stage = STAGE_SEQUENCE, .name = name, .kernel = "retuned", .items = num_notes, .seconds = best_retuned});
+}
+
+// Render the whole score through sequencer_callback with the given oscillator kernel
+static void bench_render(const char* name, const event_array_t* events, oscillator_kernel_t kernel) {
+    if (!oscillator_use_kernel(kernel)) {
+        return; // Not supported on this CPU
+    }
+
+    sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
+    if (!seq) {
+        return;
+    }
+    seq->events = *events; // Shared, read-only during playback
+    seq->sample_rate = BENCH_SAMPLE_RATE;
+
+    int16_t buffer[BENCH_QUANTUM];
+    long samples = 0;
+    double voice_samples = 0.0;
+
+    double start = monotonic_seconds();
+    bool more = true;
+    while (more) {
+        voice_samples += (double)seq->voices.num_active * BENCH_QUANTUM;
+        more = sequencer_callback(buffer, BENCH_QUANTUM, &bench_format, seq);
+        samples += BENCH_QUANTUM;
+    }
+    double elapsed = monotonic_seconds() - start;
+
+    add_result((bench_result_t){.stage = STAGE_RENDER,
+                                .name = name,
+                                .kernel = oscillator_kernel_name(),
+                                .items = samples,
+                                .voice_samples = voice_samples,
+                                .voices_stolen = seq->voices_stolen,
+                                .events_dropped = seq->events_dropped,
+                                .seconds = elapsed});
+    free(seq); // Events are owned by the caller
+}
+
+// Render the whole score as interleaved stereo F32 with the default kernel (pan and conversion cost)
+static void bench_render_stereo(const char* name, const event_array_t* events) {
+    sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
+    if (!seq) {
+        return;
+    }
+    seq->events = *events; // Shared, read-only during playback
+    seq->sample_rate = BENCH_SAMPLE_RATE;
+
+    float buffer[BENCH_QUANTUM * 2];
+    long samples = 0;
+    double voice_samples = 0.0;
+
+    double start = monotonic_seconds();
+    bool more = true;
+    while (more) {
+        voice_samples += (double)seq->voices.num_active * BENCH_QUANTUM;
+        more = sequencer_callback(buffer, BENCH_QUANTUM, &stereo_f32_format, seq);
+        samples += BENCH_QUANTUM;
+    }
+    double elapsed = monotonic_seconds() - start;
+
+    add_result((bench_result_t){.stage = STAGE_RENDER,
+                                .name = name,
+                                .kernel = "f32x2",
+                                .items = samples,
+                                .voice_samples = voice_samples,
+                                .voices_stolen = seq->voices_stolen,
+                                .events_dropped = seq->events_dropped,
+                                .seconds = elapsed});
+    free(seq); // Events are owned by the caller
+}
+
+// Render with adaptive quality pinned at its lowest (partials culled at CULL_LEVEL_MAX): the most
+// a CPU budget can save. The mix bus is rendered and converted directly, as the controller in
+// sequencer_callback would lower the level again.
+static void bench_render_culled(const char* name, const event_array_t* events) {
+    sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
+    if (!seq) {
+        return;
+    }
+    seq->events = *events; // Shared, read-only during playback
+    seq->sample_rate = BENCH_SAMPLE_RATE;
+    sequencer_set_cpu_budget(seq, 1.0f);
+    seq->cull_level = CULL_LEVEL_MAX;
+
+    int16_t buffer[BENCH_QUANTUM];
+    int32_t mix[BENCH_QUANTUM];
+    long samples = 0;
+    double voice_samples = 0.0;
+
+    double start = monotonic_seconds();
+    bool more = true;
+    while (more) {
+        voice_samples += (double)seq->voices.num_active * BENCH_QUANTUM;
+        memset(mix, 0, sizeof(mix));
+        more = sequencer_render(seq, mix, BENCH_QUANTUM, 1, BENCH_QUANTUM);
+        mix_bus_convert(mix, BENCH_QUANTUM, 1, BENCH_QUANTUM, &bench_format, buffer, 0);
+        samples += BENCH_QUANTUM;
+    }
+    double elapsed = monotonic_seconds() - start;
+
+    add_result((bench_result_t){.stage = STAGE_RENDER,
+                                .name = name,
+                                .kernel = "culled",
+                                .items = samples,
+                                .voice_samples = voice_samples,
+                                .voices_stolen = seq->voices_stolen,
+                                .events_dropped = seq->events_dropped,
+                                .seconds = elapsed});
+    free(seq); // Events are owned by the caller
+}
+
+static void bench_render_all_kernels(const char* name, const event_array_t* events) {
+    static const oscillator_kernel_t kernels[] = {OSC_KERNEL_SCALAR, OSC_KERNEL_SSE2, OSC_KERNEL_AVX2,
+                                                  OSC_KERNEL_NEON};
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        bench_render(name, events, kernels[i]);
+    }
+    oscillator_use_kernel(OSC_KERNEL_AUTO);
+}
+
+// Play the score straight from its text through a streaming sequencer (parse and sequence included)
+static void bench_render_stream(const char* name, const char* score) {
+    double start = monotonic_seconds();
+    sequencer_state_t* seq = create_streaming_sequencer(score, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament,
+                                                        0, 0.3f);
+    if (!seq) {
+        return;
+    }
+
+    int16_t buffer[BENCH_QUANTUM];
+    long samples = 0;
+    double voice_samples = 0.0;
+
+    bool more = true;
+    while (more) {
+        voice_samples += (double)seq->voices.num_active * BENCH_QUANTUM;
+        more = sequencer_callback(buffer, BENCH_QUANTUM, &bench_format, seq);
+        samples += BENCH_QUANTUM;
+    }
+    double elapsed = monotonic_seconds() - start;
+
+    add_result((bench_result_t){.stage = STAGE_RENDER,
+                                .name = name,
+                                .kernel = "stream",
+                                .items = samples,
+                                .voice_samples = voice_samples,
+                                .voices_stolen = seq->voices_stolen,
+                                .events_dropped = seq->events_dropped,
+                                .seconds = elapsed});
+    cleanup_sequencer_state(seq);
+}
+
+// Compile the events to a temporary file, then time mapping it and playing from the mapping
+static void bench_compiled(const char* name, const event_array_t* events) {
+    char path[] = "/tmp/musicbox_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+
+    if (!score_file_write(path, events, BENCH_SAMPLE_RATE)) {
+        unlink(path);
+        return;
+    }
+
+    double best = 0.0;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        score_file_t score;
+        double start = monotonic_seconds();
+        bool ok = score_file_open(&score, path);
+        double elapsed = monotonic_seconds() - start;
+        if (!ok) {
+            unlink(path);
+            return;
+        }
+        score_file_close(&score);
+
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    add_result((bench_result_t){.stage = STAGE_LOAD, .name = name, .items = events->count, .seconds = best});
+
+    score_file_t score;
+    if (score_file_open(&score, path)) {
+        sequencer_state_t* seq = create_mapped_sequencer(&score);
+        if (seq) {
+            int16_t buffer[BENCH_QUANTUM];
+            long samples = 0;
+            double voice_samples = 0.0;
+
+            double start = monotonic_seconds();
+            bool more = true;
+            while (more) {
+                voice_samples += (double)seq->voices.num_active * BENCH_QUANTUM;
+                more = sequencer_callback(buffer, BENCH_QUANTUM, &bench_format, seq);
+                samples += BENCH_QUANTUM;
+            }
+            double elapsed = monotonic_seconds() - start;
+
+            add_result((bench_result_t){.stage = STAGE_RENDER,
+                                        .name = name,
+                                        .kernel = "mapped",
+                                        .items = samples,
+                                        .voice_samples = voice_samples,
+                                        .voices_stolen = seq->voices_stolen,
+                                        .events_dropped = seq->events_dropped,
+                                        .seconds = elapsed});
+            cleanup_sequencer_state(seq);
+        }
+        score_file_close(&score);
+    }
+    unlink(path);
+}
+
+// Render BENCH_TRACKS copies of the score through multitrack_callback (labelled by workers actually spawned)
+static void bench_multitrack(const char* name, const note_array_t* notes, int num_workers) {
+    static const char* const labels[MAX_WORKERS + 1] = {"mt-w0", "mt-w1", "mt-w2", "mt-w3", "mt-w4",
+                                                        "mt-w5", "mt-w6", "mt-w7", "mt-w8"};
+
+    sequencer_state_t* tracks[BENCH_TRACKS];
+    for (int t = 0; t < BENCH_TRACKS; t++) {
+        tracks[t] = calloc(1, sizeof(sequencer_state_t));
+        if (!tracks[t]) {
+            for (int i = 0; i < t; i++) {
+                cleanup_sequencer_state(tracks[i]);
+            }
+            return;
+        }
+        tracks[t]->events = sequence_events(notes, BENCH_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.3f);
+        tracks[t]->sample_rate = BENCH_SAMPLE_RATE;
+    }
+
+    multitrack_state_t* mt = create_multitrack_state(tracks, BENCH_TRACKS, num_workers);
+    if (!mt) {
+        for (int t = 0; t < BENCH_TRACKS; t++) {
+            cleanup_sequencer_state(tracks[t]);
+        }
+        return;
+    }
+
+    int16_t buffer[BENCH_QUANTUM];
+    long samples = 0;
+    double voice_samples = 0.0;
+
+    double start = monotonic_seconds();
+    bool more = true;
+    while (more) {
+        for (int t = 0; t < BENCH_TRACKS; t++) {
+            voice_samples += (double)tracks[t]->voices.num_active * BENCH_QUANTUM;
+        }
+        more = multitrack_callback(buffer, BENCH_QUANTUM, &bench_format, mt);
+        samples += BENCH_QUANTUM;
+    }
+    double elapsed = monotonic_seconds() - start;
+
+    add_result((bench_result_t){.stage = STAGE_RENDER,
+                                .name = name,
+                                .kernel = labels[mt->num_workers],
+                                .items = samples,
+                                .voice_samples = voice_samples,
+                                .seconds = elapsed});
+    cleanup_multitrack_state(mt);
+}
+
+// Parse, sequence and optionally render one synthetic score
+static void run_score(const char* name, char* score, bool render) {
+    if (!score) {
+        fprintf(stderr, "Failed to generate %s score\n", name);
+        return;
+    }
+
+    note_array_t notes = bench_parse(name, score);
+    bench_check(name, score, notes.count);
+    event_array_t events = bench_sequence(name, &notes);
+    bench_arena(name, score);
+    bench_cached(name, score, notes.count);
+    if (render) {
+        bench_render_all_kernels(name, &events);
+        bench_render_stereo(name, &events);
+        bench_render_culled(name, &events);
+        bench_render_stream(name, score);
+        bench_compiled(name, &events);
+    }
+
+    event_array_free(&events);
+    free_note_array(&notes);
+    free(score);
+}
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+static const char* stage_name(bench_stage_t stage) {
+    switch (stage) {
+    case STAGE_PARSE:
+        return "parse";
+    case STAGE_SEQUENCE:
+        return "sequence";
+    case STAGE_RENDER:
+        return "render";
+    case STAGE_LOAD:
+        return "load";
+    default:
+        return "unknown";
+    }
+}
+
+static void print_table(void) {
+    printf("\n%-9s %-14s %-7s %10s %10s %12s %14s\n", "stage", "score", "kernel", "items", "seconds", "ns/item",
+           "ns/sample/voice");
+    for (int i = 0; i < num_results; i++) {
+        const bench_result_t* r = &results[i];
+        double ns_per_item = r->items > 0 ? r->seconds * 1e9 / r->items : 0.0;
+        printf("%-9s %-14s %-7s %10ld %10.4f %12.2f", stage_name(r->stage), r->name, r->kernel ? r->kernel : "-",
+               r->items, r->seconds, ns_per_item);
+        if (r->stage == STAGE_RENDER && r->voice_samples > 0.0) {
+            printf(" %14.3f", r->seconds * 1e9 / r->voice_samples);
+        }
+        printf("\n");
+    }
+}
+
+static void write_json(FILE* out, double scale) {
+    fprintf(out, "{\n  \"benchmark\": \"musicbox\",\n  \"sample_rate\": %d,\n  \"scale\": %g,\n", BENCH_SAMPLE_RATE,
+            scale);
+    fprintf(out, "  \"default_kernel\": \"%s\",\n  \"results\": [\n", oscillator_kernel_name());
+
+    for (int i = 0; i < num_results; i++) {
+        const bench_result_t* r = &results[i];
+        fprintf(out, "    {\"stage\": \"%s\", \"score\": \"%s\", \"seconds\": %.9f", stage_name(r->stage), r->name,
+                r->seconds);
+
+        if (r->stage == STAGE_RENDER) {
+            double avg_voices = r->items > 0 ? r->voice_samples / r->items : 0.0;
+            fprintf(out, ", \"kernel\": \"%s\", \"samples\": %ld, \"avg_voices\": %.2f", r->kernel, r->items,
+                    avg_voices);
+            fprintf(out, ", \"ns_per_sample\": %.3f, \"ns_per_sample_voice\": %.3f, \"realtime_factor\": %.1f",
+                    r->seconds * 1e9 / r->items, r->voice_samples > 0.0 ? r->seconds * 1e9 / r->voice_samples : 0.0,
+                    r->seconds > 0.0 ? r->items / (r->seconds * BENCH_SAMPLE_RATE) : 0.0);
+            fprintf(out, ", \"voices_stolen\": %u, \"events_dropped\": %u", r->voices_stolen, r->events_dropped);
+        } else if (r->stage == STAGE_LOAD) {
+            fprintf(out, ", \"events\": %ld, \"ns_per_event\": %.3f", r->items,
+                    r->items > 0 ? r->seconds * 1e9 / r->items : 0.0);
+        } else {
+            fprintf(out, ", \"notes\": %ld, \"ns_per_note\": %.3f", r->items,
+                    r->items > 0 ? r->seconds * 1e9 / r->items : 0.0);
+        }
+        fprintf(out, "}%s\n", i + 1 < num_results ? "," : "");
+    }
+
+    fprintf(out, "  ]\n}\n");
+}
+
+// ============================================================================
+// GOLDEN OUTPUT CHECK
+// ============================================================================
+
+// --golden FILE renders a fixed corpus offline and compares each render with FILE: the checksum must
+// match, or the RMS error of a decimated sample fingerprint must stay under GOLDEN_TOLERANCE_DB. Every
+// partial kernel (and the streaming sequencer, where a score allows) must produce the very same
+// samples. --update rewrites FILE from this build.
+// Render times only compare on one host, so they stay out of FILE: --baseline TIMES compares them with
+// a local file (written by the first run, or with --update) and flags renders more than --slowdown
+// percent slower.
+
+#define GOLDEN_REPEATS 5 // Best-of-N render time
+#define GOLDEN_MAX_FRAMES (1L << 20) // Renders are cut off here
+#define GOLDEN_FINGERPRINT_STRIDE 251 // Frames per fingerprint sample (prime, so it drifts across quanta)
+#define GOLDEN_MAX_FINGERPRINT ((int)(GOLDEN_MAX_FRAMES / GOLDEN_FINGERPRINT_STRIDE) + 1)
+#define GOLDEN_TOLERANCE_DB -50.0 // Fingerprint RMS error (relative to the golden RMS) still accepted
+#define GOLDEN_SLOWDOWN_PERCENT 25.0 // Default render time increase flagged
+#define GOLDEN_LINE_MAX (GOLDEN_MAX_FINGERPRINT * 7 + 128)
+
+typedef struct {
+    const char* name;
+    const char* score;
+    int tempo_bpm;
+    const key_signature_t* key;
+    const temperament_t* temperament;
+    int transposition;
+    float volume;
+    float speed; // Live tempo change posted before playback, 0 = none
+    float transpose; // Live transposition in semitones posted before playback, 0 = none
+    bool stream; // Single timeline: the streaming sequencer must render it identically
+    float seek_at; // Playback seconds at which a seek to seek_to is posted
+    float seek_to; // Score seconds to seek to, 0 = no seek
+    bool culled; // Rendered with the adaptive-quality cull level pinned at CULL_LEVEL_MAX
+} golden_score_t;
+
+static const golden_score_t golden_corpus[] = {
+    {"melody", "c4 d e f g a b c'2", 120, &c_major, &equal_temperament, 0, 0.9f, 0.0f, 0.0f, true, 0.0f, 0.0f, false},
+    {"chords", "<c e g>2 <f a c'>2 <g b d'>2 <c' e' g' c''>1", 100, &c_major, &equal_temperament, 0, 0.9f, 0.0f, 0.0f,
+     true, 0.0f, 0.0f, false},
+    {"rhythms", "[pluck sine] c8 e g c'4. r8 b8t a8t g8t fs16 e16 d,4 bf,, [pluck square] <c e g>2", 132, &c_major,
+     &equal_temperament, 0, 0.5f, 0.0f, 0.0f, true, 0.0f, 0.0f, false},
+    {"wavetables", "[saw] c8 d e f [square] g a b c' [triangle] <c e g>2 [saw] c''4 c,,4", 120, &c_major,
+     &equal_temperament, 0, 0.4f, 0.0f, 0.0f, true, 0.0f, 0.0f, false},
+    {"werckmeister", "g4 a b c' d'2 <g b d'>2 f4 f'", 90, &g_major, &werckmeister3_temperament, -3, 0.6f, 0.0f, 0.0f,
+     true, 0.0f, 0.0f, false},
+    {"canon", "{v1} c4 d e f g a g f e f d e c2 {v2} r2 c4 d e f g a g f e f d e c2", 140, &c_major,
+     &equal_temperament, 0, 0.4f, 0.0f, 0.0f, false, 0.0f, 0.0f, false},
+    {"live", "[square] c4 e g c' <c e g c'>2", 120, &c_major, &equal_temperament, 0, 0.5f, 1.5f, 2.0f, true, 0.0f,
+     0.0f, false},
+    {"steal", "<c e g b d' f' a' c''>16 <d f a c' e' g' b' d''>16 <f a c' e' g' b' d'' f''>16 "
+              "<g, b, d f a c' e' g'>16 <c e g b d' f' a' c''>16 <d f a c' e' g' b' d''>16 "
+              "<f a c' e' g' b' d'' f''>16 <g, b, d f a c' e' g'>16 <c e g b d' f' a' c''>2",
+     120, &c_major, &equal_temperament, 0, 0.3f, 0.0f, 0.0f, true, 0.0f, 0.0f, false},
+    // Lands mid-note in a pluck, with the released chord's tail still resumed (text streams cannot seek)
+    {"seek", "[pluck sine] c4 d e f <g b d'>2 [pluck square] a4 g f e <d f a>2 c1", 120, &c_major,
+     &equal_temperament, 0, 0.5f, 0.0f, 0.0f, false, 0.75f, 3.1f, false},
+    // Dense enough for the CPU budget to cull quiet voices
+    {"culled",
+     "[pluck square] <c e g b d' f'>2 <d f a c' e' g'>2 [saw] <c e g c'>4 <d f a d'>4 [pluck sine] <c e g c'>1", 120,
+     &c_major, &equal_temperament, 0, 0.3f, 0.0f, 0.0f, true, 0.0f, 0.0f, true},
+};
+
+#define GOLDEN_CORPUS_SIZE ((int)(sizeof(golden_corpus) / sizeof(golden_corpus[0])))
+
+typedef struct {
+    char name[64];
+    long frames;
+    uint64_t checksum; // FNV-1a over the S16 samples
+    double ns_per_frame;
+    int num_fingerprint;
+    int16_t fingerprint[GOLDEN_MAX_FINGERPRINT]; // Every GOLDEN_FINGERPRINT_STRIDE-th sample
+} golden_render_t;
+
+typedef struct {
+    char name[64];
+    double ns_per_frame;
+} golden_timing_t;
+
+// Render one corpus entry to mono S16 through sequencer_callback (sequencer_render when culled, so
+// the pinned level does not adapt), optionally as a text stream
+static bool golden_render(const golden_score_t* g, bool stream, golden_render_t* out) {
+    note_array_t notes = {0};
+    sequencer_state_t* seq;
+    if (stream) {
+        seq = create_streaming_sequencer(g->score, BENCH_SAMPLE_RATE, g->tempo_bpm, g->key, g->temperament,
+                                         g->transposition, g->volume);
+    } else {
+        notes = parse_music(g->score);
+        seq = calloc(1, sizeof(sequencer_state_t));
+        if (seq) {
+            seq->events = sequence_events(&notes, BENCH_SAMPLE_RATE, g->tempo_bpm, g->key, g->temperament,
+                                          g->transposition, g->volume);
+            seq->sample_rate = BENCH_SAMPLE_RATE;
+        }
+        free_note_array(&notes);
+    }
+    if (!seq) {
+        return false;
+    }
+    if (g->speed > 0.0f) {
+        sequencer_set_tempo(seq, g->speed);
+    }
+    if (g->transpose != 0.0f) {
+        sequencer_set_transpose(seq, g->transpose);
+    }
+    if (g->culled) {
+        sequencer_set_cpu_budget(seq, 1.0f);
+        seq->cull_level = CULL_LEVEL_MAX;
+    }
+    long seek_frame = g->seek_to > 0.0f ? (long)(g->seek_at * BENCH_SAMPLE_RATE) : -1;
+
+    snprintf(out->name, sizeof(out->name), "%s", g->name);
+    out->frames = 0;
+    out->checksum = 0xCBF29CE484222325ull;
+    out->num_fingerprint = 0;
+
+    int16_t buffer[BENCH_QUANTUM];
+    int32_t mix[BENCH_QUANTUM];
+    double start = monotonic_seconds();
+    bool more = true;
+    while (more && out->frames < GOLDEN_MAX_FRAMES) {
+        if (seek_frame >= 0 && out->frames >= seek_frame) {
+            sequencer_seek(seq, (uint64_t)(g->seek_to * BENCH_SAMPLE_RATE));
+            seek_frame = -1;
+        }
+        if (g->culled) {
+            memset(mix, 0, sizeof(mix));
+            more = sequencer_render(seq, mix, BENCH_QUANTUM, 1, BENCH_QUANTUM);
+            mix_bus_convert(mix, BENCH_QUANTUM, 1, BENCH_QUANTUM, &bench_format, buffer, 0);
+        } else {
+            more = sequencer_callback(buffer, BENCH_QUANTUM, &bench_format, seq);
+        }
+        for (int i = 0; i < BENCH_QUANTUM; i++) {
+            uint16_t sample = (uint16_t)buffer[i];
+            out->checksum = (out->checksum ^ (sample & 0xFF)) * 0x100000001B3ull;
+            out->checksum = (out->checksum ^ (sample >> 8)) * 0x100000001B3ull;
+            if ((out->frames + i) % GOLDEN_FINGERPRINT_STRIDE == 0) {
+                out->fingerprint[out->num_fingerprint++] = buffer[i];
+            }
+        }
+        out->frames += BENCH_QUANTUM;
+    }
+    out->ns_per_frame = (monotonic_seconds() - start) * 1e9 / out->frames;
+
+    cleanup_sequencer_state(seq);
+    return true;
+}
+
+// Render with every partial kernel (and as a stream where allowed): all must agree sample for sample.
+// Returns false on a disagreement, with the default kernel's render and best time in *out.
+static bool golden_render_all(const golden_score_t* g, golden_render_t* out) {
+    static const oscillator_kernel_t kernels[] = {OSC_KERNEL_SCALAR, OSC_KERNEL_SSE2, OSC_KERNEL_AVX2,
+                                                  OSC_KERNEL_NEON};
+    static golden_render_t other;
+    bool agree = true;
+
+    oscillator_use_kernel(OSC_KERNEL_AUTO);
+    double best = 0.0;
+    for (int r = 0; r < GOLDEN_REPEATS; r++) {
+        if (!golden_render(g, false, out)) {
+            return false;
+        }
+        if (r == 0 || out->ns_per_frame < best) {
+            best = out->ns_per_frame;
+        }
+    }
+    out->ns_per_frame = best;
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (oscillator_use_kernel(kernels[k]) && golden_render(g, false, &other) &&
+            (other.checksum != out->checksum || other.frames != out->frames)) {
+            fprintf(stderr, "%s: the %s kernel renders differently\n", g->name, oscillator_kernel_name());
+            agree = false;
+        }
+    }
+    oscillator_use_kernel(OSC_KERNEL_AUTO);
+
+    if (g->stream && golden_render(g, true, &other) &&
+        (other.checksum != out->checksum || other.frames != out->frames)) {
+        fprintf(stderr, "%s: the streaming sequencer renders differently\n", g->name);
+        agree = false;
+    }
+    return agree;
+}
+
+// Read the renders in a golden file, returns how many (-1 if it cannot be opened)
+static int read_golden_file(const char* path, golden_render_t* renders, int max_renders) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        return -1;
+    }
+
+    static char line[GOLDEN_LINE_MAX];
+    int count = 0;
+    while (count < max_renders && fgets(line, sizeof(line), in)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        golden_render_t* r = &renders[count];
+        unsigned long long checksum;
+        int offset = 0;
+        if (sscanf(line, "%63s %ld %llx%n", r->name, &r->frames, &checksum, &offset) != 3) {
+            continue;
+        }
+        r->checksum = checksum;
+        r->ns_per_frame = 0.0;
+        r->num_fingerprint = 0;
+
+        char* p = line + offset;
+        char* end;
+        while (r->num_fingerprint < GOLDEN_MAX_FINGERPRINT) {
+            long sample = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            r->fingerprint[r->num_fingerprint++] = (int16_t)sample;
+            p = end;
+        }
+        count++;
+    }
+
+    fclose(in);
+    return count;
+}
+
+static bool write_golden_file(const char* path, const golden_render_t* renders, int count) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        return false;
+    }
+
+    fprintf(out, "# musicbox_bench --golden: mono S16 at %d Hz\n", BENCH_SAMPLE_RATE);
+    fprintf(out, "# score frames fnv1a64 samples[every %d frames]...\n", GOLDEN_FINGERPRINT_STRIDE);
+    for (int i = 0; i < count; i++) {
+        const golden_render_t* r = &renders[i];
+        fprintf(out, "%s %ld %016llx", r->name, r->frames, (unsigned long long)r->checksum);
+        for (int s = 0; s < r->num_fingerprint; s++) {
+            fprintf(out, " %d", r->fingerprint[s]);
+        }
+        fprintf(out, "\n");
+    }
+
+    return fclose(out) == 0;
+}
+
+// Read a render time baseline, returns how many entries (-1 if it cannot be opened)
+static int read_baseline_file(const char* path, golden_timing_t* timings, int max_timings) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        return -1;
+    }
+
+    char line[256];
+    int count = 0;
+    while (count < max_timings && fgets(line, sizeof(line), in)) {
+        golden_timing_t* t = &timings[count];
+        if (line[0] != '#' && sscanf(line, "%63s %lf", t->name, &t->ns_per_frame) == 2) {
+            count++;
+        }
+    }
+
+    fclose(in);
+    return count;
+}
+
+static bool write_baseline_file(const char* path, const golden_render_t* renders, int count) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        return false;
+    }
+
+    fprintf(out, "# musicbox_bench --baseline: best of %d renders on the host that wrote it\n", GOLDEN_REPEATS);
+    fprintf(out, "# score ns_per_frame\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s %.2f\n", renders[i].name, renders[i].ns_per_frame);
+    }
+
+    return fclose(out) == 0;
+}
+
+// RMS error between two fingerprints relative to the golden RMS, in dB (missing samples count as silence)
+static double sample_error_db(const golden_render_t* render, const golden_render_t* golden) {
+    int samples = render->num_fingerprint > golden->num_fingerprint ? render->num_fingerprint : golden->num_fingerprint;
+    double error = 0.0, reference = 0.0;
+
+    for (int s = 0; s < samples; s++) {
+        double x = s < render->num_fingerprint ? render->fingerprint[s] : 0.0;
+        double y = s < golden->num_fingerprint ? golden->fingerprint[s] : 0.0;
+        error += (x - y) * (x - y);
+        reference += y * y;
+    }
+    if (error == 0.0) {
+        return -HUGE_VAL;
+    }
+    return reference > 0.0 ? 10.0 * log10(error / reference) : HUGE_VAL;
+}
+
+// Returns the exit status: 0 when everything matches, 1 on a mismatch, 2 when only slower than the baseline
+static int run_golden(const char* path, bool update, const char* baseline_path, double slowdown_percent) {
+    static golden_render_t golden[GOLDEN_CORPUS_SIZE];
+    static golden_render_t renders[GOLDEN_CORPUS_SIZE];
+    static golden_timing_t baseline[GOLDEN_CORPUS_SIZE];
+
+    int num_golden = update ? 0 : read_golden_file(path, golden, GOLDEN_CORPUS_SIZE);
+    if (num_golden < 0) {
+        fprintf(stderr, "Failed to read %s (write it with --update)\n", path);
+        return 1;
+    }
+    int num_baseline = baseline_path && !update ? read_baseline_file(baseline_path, baseline, GOLDEN_CORPUS_SIZE) : -1;
+
+    bool mismatch = false, slower = false;
+    printf("%-14s %9s %-16s %-10s %10s %10s %8s\n", "score", "frames", "checksum", "result", "error dB", "ns/frame",
+           "change");
+    for (int i = 0; i < GOLDEN_CORPUS_SIZE; i++) {
+        golden_render_t* r = &renders[i];
+        if (!golden_render_all(&golden_corpus[i], r)) {
+            mismatch = true;
+        }
+
+        const golden_render_t* g = NULL;
+        for (int j = 0; j < num_golden; j++) {
+            if (strcmp(golden[j].name, r->name) == 0) {
+                g = &golden[j];
+            }
+        }
+        const golden_timing_t* t = NULL;
+        for (int j = 0; j < num_baseline; j++) {
+            if (strcmp(baseline[j].name, r->name) == 0) {
+                t = &baseline[j];
+            }
+        }
+
+        const char* result = "written";
+        double error_db = -HUGE_VAL;
+        if (!update && !g) {
+            result = "MISSING";
+            mismatch = true;
+        } else if (g) {
+            error_db = g->checksum == r->checksum && g->frames == r->frames ? -HUGE_VAL : sample_error_db(r, g);
+            if (error_db == -HUGE_VAL) {
+                result = "exact";
+            } else if (error_db <= GOLDEN_TOLERANCE_DB) {
+                result = "close";
+            } else {
+                result = "MISMATCH";
+                mismatch = true;
+            }
+        }
+
+        char level[16] = "-";
+        if (error_db != -HUGE_VAL) {
+            snprintf(level, sizeof(level), "%.1f", error_db);
+        }
+        char change[24] = "-";
+        if (t && t->ns_per_frame > 0.0) {
+            double percent = (r->ns_per_frame / t->ns_per_frame - 1.0) * 100.0;
+            snprintf(change, sizeof(change), "%+.1f%%%s", percent, percent > slowdown_percent ? " SLOWER" : "");
+            slower |= percent > slowdown_percent;
+        }
+        printf("%-14s %9ld %016llx %-10s %10s %10.2f %8s\n", r->name, r->frames, (unsigned long long)r->checksum,
+               result, level, r->ns_per_frame, change);
+    }
+
+    // A missing baseline is recorded now, for the next run to compare with
+    if (baseline_path && num_baseline < 0) {
+        if (!write_baseline_file(baseline_path, renders, GOLDEN_CORPUS_SIZE)) {
+            fprintf(stderr, "Failed to write %s\n", baseline_path);
+            return 1;
+        }
+        printf("\nWrote %s\n", baseline_path);
+    }
+    if (update) {
+        if (!write_golden_file(path, renders, GOLDEN_CORPUS_SIZE)) {
+            fprintf(stderr, "Failed to write %s\n", path);
+            return 1;
+        }
+        printf("\nWrote %s\n", path);
+        return mismatch ? 1 : 0;
+    }
+    return mismatch ? 1 : slower ? 2 : 0;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    const char* json_path = NULL;
+    const char* golden_path = NULL;
+    const char* baseline_path = NULL;
+    bool update_golden = false;
+    double scale = 1.0;
+    double slowdown_percent = GOLDEN_SLOWDOWN_PERCENT;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_path = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0) {
+            update_golden = true;
+        } else if (strcmp(argv[i], "--slowdown") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0) {
+            slowdown_percent = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--json FILE] [--scale FACTOR]\n", argv[0]);
+            fprintf(stderr, "       %s --golden FILE [--update] [--baseline TIMES [--slowdown PERCENT]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (scale <= 0.0) {
+        scale = 1.0;
+    }
+
+    music_init();
+
+    if (golden_path) {
+        sequencer_verbose = false; // Keep the report readable
+        return run_golden(golden_path, update_golden, baseline_path, slowdown_percent);
+    }
+
+    // Parser and sequencer throughput on long inputs
+    run_score("melody_1m", generate_melody((long)(1000000 * scale)), false);
+    run_score("indented_1m", generate_indented_melody((long)(1000000 * scale)), false);
+    run_score("tracks_16", generate_tracks((long)(1000000 * scale)), false); // Per-track timelines, k-way merge
+    run_score("chords_8", generate_chords((long)(4000 * scale), "", "8"), false);
+
+    // Renderer at full 32-voice polyphony (sustained chords overlap through their release)
+    run_score("poly32_sine", generate_chords((long)(480 * scale), "", "16"), true);
+    run_score("poly32_square", generate_chords((long)(480 * scale), "[pluck square] ", "16"), true);
+    run_score("poly32_wave", generate_chords((long)(480 * scale), "[square] ", "16"), true); // Band-limited table
+
+    // Multi-track scaling: the same tracks rendered on the callback thread alone and with workers
+    char* score = generate_chords((long)(480 * scale), "", "16");
+    if (score) {
+        note_array_t notes = parse_music(score);
+        bench_multitrack("tracks4_poly32", &notes, 0);
+        bench_multitrack("tracks4_poly32", &notes, BENCH_TRACKS - 1);
+        free_note_array(&notes);
+        free(score);
+    }
+
+    print_table();
+
+    if (json_path) {
+        FILE* out = fopen(json_path, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", json_path);
+            return 1;
+        }
+        write_json(out, scale);
+        fclose(out);
+        printf("\nWrote %s\n", json_path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include "file_driver.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rt_log.h"
+#include "rt_stats.h"
+
+// ============================================================================
+// FILE DRIVER TYPES
+// ============================================================================
+
+#define FILE_QUANTUM_FRAMES 1024  // Frames requested from the callback per call
+#define FILE_BUFFER_BYTES (256 * 1024)  // Bytes buffered before each fwrite
+#define WAV_HEADER_SIZE 44
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_IEEE_FLOAT 3
+
+typedef struct {
+    FILE *file;
+    file_format_t format;
+    audio_format_t audio;
+    audio_callback_t callback;
+    void *user_data;
+    bool playing;
+    uint64_t frames_written;
+    file_driver_stats_t stats;
+    size_t buffered; // Bytes
+    uint8_t buffer[FILE_BUFFER_BYTES];
+} file_audio_context_t;
+
+enum {
+    FILE_ERROR_NONE,
+    FILE_ERROR_ALLOC,
+    FILE_ERROR_FORMAT,
+};
+
+// ============================================================================
+// FILE DRIVER GLOBAL STATE
+// ============================================================================
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;  // Unused parameter
+    interrupted = 1;
+}
+
+void file_driver_setup_signals(void) {
+    signal(SIGINT, signal_handler);
+}
+
+// ============================================================================
+// WAV OUTPUT
+// ============================================================================
+
+static void put_u16_le(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32_le(uint8_t *p, uint32_t value) {
+    put_u16_le(p, (uint16_t)value);
+    put_u16_le(p + 2, (uint16_t)(value >> 16));
+}
+
+// Write (or rewrite, once the length is known) the 44-byte WAV header
+static bool write_wav_header(FILE *file, const audio_format_t *audio, uint64_t num_frames) {
+    uint8_t header[WAV_HEADER_SIZE];
+    uint32_t frame_size = (uint32_t)audio_frame_size(audio);
+    uint32_t data_size = (uint32_t)(num_frames * frame_size);
+    uint16_t tag = audio->format == AUDIO_FORMAT_F32 ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM;
+
+    memcpy(header, "RIFF", 4);
+    put_u32_le(header + 4, 36 + data_size);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    put_u32_le(header + 16, 16);                  // PCM fmt chunk size
+    put_u16_le(header + 20, tag);                 // PCM or IEEE float
+    put_u16_le(header + 22, (uint16_t)audio->channels);
+    put_u32_le(header + 24, audio->sample_rate);
+    put_u32_le(header + 28, audio->sample_rate * frame_size);  // Byte rate
+    put_u16_le(header + 32, (uint16_t)frame_size);  // Block align
+    put_u16_le(header + 34, (uint16_t)(frame_size / audio->channels * 8));  // Bits per sample
+    memcpy(header + 36, "data", 4);
+    put_u32_le(header + 40, data_size);
+
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+static bool flush_buffer(file_audio_context_t *ctx) {
+    if (ctx->buffered == 0) {
+        return true;
+    }
+
+    if (ctx->format == FILE_FORMAT_WAV) {
+        // WAV is little-endian; swap each sample in place on big-endian hosts
+        const uint16_t probe = 1;
+        if (*(const uint8_t *)&probe == 0) {
+            size_t width = audio_frame_size(&ctx->audio) / ctx->audio.channels;
+            for (size_t i = 0; i < ctx->buffered; i += width) {
+                for (size_t lo = i, hi = i + width - 1; lo < hi; lo++, hi--) {
+                    uint8_t byte = ctx->buffer[lo];
+                    ctx->buffer[lo] = ctx->buffer[hi];
+                    ctx->buffer[hi] = byte;
+                }
+            }
+        }
+    }
+
+    size_t frame_size = audio_frame_size(&ctx->audio);
+    size_t frames = ctx->buffered / frame_size;
+    size_t written = fwrite(ctx->buffer, frame_size, frames, ctx->file);
+    ctx->frames_written += written;
+    bool ok = written == frames;
+    ctx->buffered = 0;
+    return ok;
+}
+
+// ============================================================================
+// FILE DRIVER IMPLEMENTATION
+// ============================================================================
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool file_driver_open(void *context, const char *path, file_format_t format) {
+    file_audio_context_t *ctx = context;
+
+    ctx->file = fopen(path, "wb");
+    if (!ctx->file) {
+        return false;
+    }
+
+    ctx->format = format;
+    ctx->frames_written = 0;
+    if (format == FILE_FORMAT_WAV && !write_wav_header(ctx->file, &ctx->audio, 0)) {
+        fclose(ctx->file);
+        ctx->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+void file_driver_render(void *context) {
+    file_audio_context_t *ctx = context;
+    double start = monotonic_seconds();
+    uint64_t rendered = 0;
+    size_t quantum_bytes = FILE_QUANTUM_FRAMES * audio_frame_size(&ctx->audio);
+
+    while (ctx->playing && ctx->callback && ctx->file && !interrupted) {
+        if (ctx->buffered + quantum_bytes > FILE_BUFFER_BYTES && !flush_buffer(ctx)) {
+            printf("Failed to write output file\n");
+            ctx->playing = false;
+            break;
+        }
+
+        uint64_t render_start = RT_STATS_NOW();
+        bool continue_playing =
+            ctx->callback(&ctx->buffer[ctx->buffered], FILE_QUANTUM_FRAMES, &ctx->audio, ctx->user_data);
+        RT_STATS_QUANTUM(FILE_QUANTUM_FRAMES, ctx->audio.sample_rate, RT_STATS_NOW() - render_start);
+        ctx->buffered += quantum_bytes;
+        rendered += FILE_QUANTUM_FRAMES;
+        rt_log_drain();
+
+        if (!continue_playing) {
+            ctx->playing = false;
+            ctx->user_data = NULL;  // Callback finished the song
+        }
+    }
+
+    if (ctx->file) {
+        flush_buffer(ctx);
+        fflush(ctx->file);
+    }
+
+    double elapsed = monotonic_seconds() - start;
+    ctx->stats.samples_rendered = rendered;
+    ctx->stats.elapsed_seconds = elapsed;
+    ctx->stats.samples_per_second = elapsed > 0.0 ? rendered / elapsed : 0.0;
+    ctx->stats.realtime_factor = ctx->stats.samples_per_second / ctx->audio.sample_rate;
+}
+
+file_driver_stats_t file_driver_get_stats(void *context) {
+    file_audio_context_t *ctx = context;
+    return ctx->stats;
+}
+
+static void* file_init(const audio_format_t *format, audio_callback_t callback, int *error) {
+    if (format->channels < 1 || format->channels > AUDIO_MAX_CHANNELS || format->sample_rate == AUDIO_RATE_NATIVE) {
+        *error = FILE_ERROR_FORMAT;
+        return NULL;
+    }
+
+    file_audio_context_t *ctx = calloc(1, sizeof(file_audio_context_t));
+    if (!ctx) {
+        *error = FILE_ERROR_ALLOC;
+        return NULL;
+    }
+
+    ctx->audio = *format;
+    ctx->callback = callback;
+    ctx->playing = false;
+
+    *error = FILE_ERROR_NONE;
+    return ctx;
+}
+
+static void file_play(void *context, void *user_data) {
+    file_audio_context_t *ctx = context;
+    ctx->user_data = user_data;
+    ctx->playing = true;
+    printf("Started rendering\n");
+}
+
+static void file_stop(void *context) {
+    file_audio_context_t *ctx = context;
+    ctx->playing = false;
+    printf("Stopped rendering\n");
+}
+
+static void file_resume(void *context) {
+    file_audio_context_t *ctx = context;
+    if (ctx->user_data) {
+        ctx->playing = true;
+        printf("Resumed rendering\n");
+    }
+}
+
+static void file_cleanup(void *context) {
+    file_audio_context_t *ctx = context;
+
+    if (ctx->file) {
+        flush_buffer(ctx);
+        if (ctx->format == FILE_FORMAT_WAV && fseek(ctx->file, 0, SEEK_SET) == 0) {
+            write_wav_header(ctx->file, &ctx->audio, ctx->frames_written);
+        }
+        fclose(ctx->file);
+    }
+
+    free(ctx);
+}
+
+static const audio_format_t* file_format(void *context) {
+    file_audio_context_t *ctx = context;
+    return &ctx->audio;
+}
+
+static const char* file_strerror(int error_code) {
+    switch (error_code) {
+        case FILE_ERROR_NONE: return "Success";
+        case FILE_ERROR_ALLOC: return "Memory allocation failed";
+        case FILE_ERROR_FORMAT: return "Unsupported format (a file needs an explicit rate)";
+        default: return "Unknown error";
+    }
+}
+
+// File driver vtable
+const audio_driver_t file_driver = {
+    .init = file_init,
+    .play = file_play,
+    .stop = file_stop,
+    .resume = file_resume,
+    .cleanup = file_cleanup,
+    .strerror = file_strerror,
+    .format = file_format
+};
@@ -0,0 +1,35 @@
+#ifndef FILE_DRIVER_H
+#define FILE_DRIVER_H
+
+#include <stdint.h>
+#include "audio_driver.h"
+
+// Offline implementation of audio_driver_t: pulls the callback as fast as possible
+// and streams the output to a WAV or raw file (in the init format) instead of a sound card.
+extern const audio_driver_t file_driver;
+
+typedef enum {
+    FILE_FORMAT_WAV, // RIFF/WAVE, PCM for S16/S32, IEEE float for F32
+    FILE_FORMAT_RAW, // Headerless interleaved samples, native byte order
+} file_format_t;
+
+typedef struct {
+    uint64_t samples_rendered; // Frames
+    double elapsed_seconds; // Wall-clock time spent rendering and writing
+    double samples_per_second; // Frames per second
+    double realtime_factor; // Audio seconds rendered per wall-clock second
+} file_driver_stats_t;
+
+// Setup signal handling for clean shutdown (call from main)
+void file_driver_setup_signals(void);
+
+// Open the output file (call after init, before play). Returns false on failure.
+bool file_driver_open(void *context, const char *path, file_format_t format);
+
+// Render until the callback finishes the song, stop() is called or interrupted
+void file_driver_render(void *context);
+
+// Throughput of the last render
+file_driver_stats_t file_driver_get_stats(void *context);
+
+#endif // FILE_DRIVER_H
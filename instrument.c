@@ -1,6 +1,8 @@
 #include "instrument.h"
 
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <strings.h>
 
@@ -9,6 +11,7 @@
 // ============================================================================
 
 #define AUDIBLE_THRESHOLD 0x00001000 // Q1.31 threshold for inaudible level (~0.1% of full scale)
+#define MAX_CACHED_INSTRUMENTS 16 // Distinct instruments with a cached partial table
 
 // ============================================================================
 // ENVELOPE FUNCTIONS
@@ -28,6 +31,22 @@ int32_t pluck_envelope(void* state, uint32_t samples_since_start, int32_t sample
     return pluck->current_level;
 }
 
+int32_t adsr_release_coeff(uint32_t release_samples, uint32_t min_release_samples) {
+    // Using target ratio of -60dB (0.001) for natural decay
+    double target_ratio = 0.00001; // -60dB
+    uint32_t effective_release_samples = release_samples;
+
+    // Enforce minimum release time to prevent clicks (20ms minimum)
+    if (effective_release_samples < min_release_samples) {
+        effective_release_samples = min_release_samples;
+    }
+
+    // RC-circuit inspired exponential coefficient
+    // rate = exp(-log((1 + targetRatio) / targetRatio) / time)
+    double rate = exp(-log((1.0 + target_ratio) / target_ratio) / effective_release_samples);
+    return (int32_t)(rate * 0x7FFFFFFF); // Convert to Q1.31
+}
+
 int32_t adsr_envelope(void* state, uint32_t samples_since_start, int32_t samples_until_release) {
     adsr_t* adsr = (adsr_t*)state;
 
@@ -39,20 +58,10 @@ int32_t adsr_envelope(void* state, uint32_t samples_since_start, int32_t samples
             adsr->release_start_level = adsr->current_level;
             adsr->phase = ADSR_RELEASE;
 
-            // Calculate exponential release coefficient
-            // Using target ratio of -60dB (0.001) for natural decay
-            double target_ratio = 0.00001; // -60dB
-            uint32_t effective_release_samples = adsr->release_samples;
-
-            // Enforce minimum release time to prevent clicks (20ms minimum)
-            if (effective_release_samples < adsr->min_release_samples) {
-                effective_release_samples = adsr->min_release_samples;
+            // Normally precomputed at sequence time; derive it here for hand-built states
+            if (adsr->release_coeff == 0) {
+                adsr->release_coeff = adsr_release_coeff(adsr->release_samples, adsr->min_release_samples);
             }
-
-            // RC-circuit inspired exponential coefficient
-            // rate = exp(-log((1 + targetRatio) / targetRatio) / time)
-            double rate = exp(-log((1.0 + target_ratio) / target_ratio) / effective_release_samples);
-            adsr->release_coeff = (int32_t)(rate * 0x7FFFFFFF); // Convert to Q1.31
         }
 
         // Exponential decay using iterative multiplication
@@ -74,8 +83,8 @@ int32_t adsr_envelope(void* state, uint32_t samples_since_start, int32_t samples
         adsr->phase = ADSR_DECAY;
         // Linear ramp from full scale to sustain_level over decay_samples
         uint32_t decay_progress = samples_since_start - adsr->attack_samples;
-        int32_t decay_range = 0x7FFFFFFF - adsr->sustain_level;
-        int32_t decay_amount = ((int64_t)decay_progress * decay_range) / adsr->decay_samples;
+        int64_t decay_range = (int64_t)0x7FFFFFFF - adsr->sustain_level;
+        int32_t decay_amount = (int32_t)(((int64_t)decay_progress * decay_range) / adsr->decay_samples);
         adsr->current_level = 0x7FFFFFFF - decay_amount;
     } else {
         // Sustain phase
@@ -86,6 +95,208 @@ int32_t adsr_envelope(void* state, uint32_t samples_since_start, int32_t samples
     return adsr->current_level;
 }
 
+// ============================================================================
+// BLOCK ENVELOPE EVALUATION
+// ============================================================================
+
+// levels[k] = base + dir * floor((t0 + k) * range / length), stepped without per-sample divides.
+// Matches the per-sample ramps in adsr_envelope exactly (range >= 0, t0 + num_samples <= length).
+static void fill_linear_ramp(int32_t* levels, size_t num_samples, uint32_t t0, int32_t base, int32_t range,
+                             uint32_t length, int dir) {
+    int64_t numerator = (int64_t)t0 * range;
+    int64_t q = numerator / length;
+    int64_t r = numerator % length;
+    const int64_t step_q = range / length;
+    const int64_t step_r = range % length;
+
+    for (size_t k = 0; k < num_samples; k++) {
+        levels[k] = base + dir * (int32_t)q;
+        q += step_q;
+        r += step_r;
+        if (r >= length) {
+            r -= length;
+            q++;
+        }
+    }
+}
+
+static void adsr_render_block(adsr_t* adsr, uint32_t samples_since_start, int32_t samples_until_release,
+                              int32_t* levels, size_t num_samples) {
+    if (samples_until_release <= 0) {
+        if (adsr->phase != ADSR_RELEASE) {
+            adsr->release_start_level = adsr->current_level;
+            adsr->phase = ADSR_RELEASE;
+            if (adsr->release_coeff == 0) {
+                adsr->release_coeff = adsr_release_coeff(adsr->release_samples, adsr->min_release_samples);
+            }
+        }
+
+        // Exponential release: one multiply per sample, clamped to zero once inaudible
+        int32_t level = adsr->current_level;
+        const int32_t coeff = adsr->release_coeff;
+        for (size_t i = 0; i < num_samples; i++) {
+            level = (int32_t)(((int64_t)level * coeff) >> 31);
+            if (level < AUDIBLE_THRESHOLD / 4) {
+                level = 0;
+            }
+            levels[i] = level;
+        }
+        adsr->current_level = level;
+        return;
+    }
+
+    const int32_t attack_range = 0x7FFFFFFF - AUDIBLE_THRESHOLD;
+    const int64_t decay_range = (int64_t)0x7FFFFFFF - adsr->sustain_level; // Sustain is never negative
+    const uint32_t decay_end = adsr->attack_samples + adsr->decay_samples;
+
+    // Attack, decay and sustain segments that fall inside this block
+    size_t i = 0;
+    while (i < num_samples) {
+        uint32_t t = samples_since_start + (uint32_t)i;
+        size_t segment = num_samples - i;
+
+        if (t < adsr->attack_samples) {
+            if (segment > adsr->attack_samples - t) {
+                segment = adsr->attack_samples - t;
+            }
+            adsr->phase = ADSR_ATTACK;
+            fill_linear_ramp(&levels[i], segment, t, AUDIBLE_THRESHOLD, attack_range, adsr->attack_samples, 1);
+        } else if (t < decay_end) {
+            if (segment > decay_end - t) {
+                segment = decay_end - t;
+            }
+            adsr->phase = ADSR_DECAY;
+            fill_linear_ramp(&levels[i], segment, t - adsr->attack_samples, 0x7FFFFFFF, (int32_t)decay_range,
+                             adsr->decay_samples, -1);
+        } else {
+            adsr->phase = ADSR_SUSTAIN;
+            for (size_t k = 0; k < segment; k++) {
+                levels[i + k] = adsr->sustain_level;
+            }
+        }
+        i += segment;
+    }
+
+    adsr->current_level = levels[num_samples - 1];
+}
+
+int32_t envelope_render_block(const instrument_t* instrument, envelope_state_t* state, uint32_t samples_since_start,
+                              int32_t samples_until_release, int32_t* levels, size_t num_samples) {
+    if (num_samples == 0) {
+        return 0;
+    }
+
+    if (!instrument || !instrument->envelope) {
+        // Full volume if no envelope function
+        for (size_t i = 0; i < num_samples; i++) {
+            levels[i] = 0x7FFFFFFF;
+        }
+    } else if (instrument->envelope == adsr_envelope) {
+        adsr_render_block(&state->adsr, samples_since_start, samples_until_release, levels, num_samples);
+    } else if (instrument->envelope == pluck_envelope) {
+        // Exponential decay: current_level *= decay_multiplier
+        pluck_decay_t* pluck = &state->pluck;
+        int32_t level = pluck->current_level;
+        for (size_t i = 0; i < num_samples; i++) {
+            level = (int32_t)(((int64_t)level * pluck->decay_multiplier) >> 31);
+            levels[i] = level;
+        }
+        pluck->current_level = level;
+    } else {
+        // Custom envelope: per-sample call
+        for (size_t i = 0; i < num_samples; i++) {
+            levels[i] = instrument->envelope(state, samples_since_start + (uint32_t)i,
+                                             samples_until_release - (int32_t)i);
+        }
+    }
+
+    return levels[num_samples - 1];
+}
+
+// ============================================================================
+// ENVELOPE FAST-FORWARD (SEEKING)
+// ============================================================================
+
+// Samples for a Q1.31 exponential (level *= multiplier per sample) to fall from `level` below `floor`
+static uint32_t exponential_samples_until(int32_t level, int32_t multiplier, int32_t floor) {
+    if (level < floor) {
+        return 0;
+    }
+    if (multiplier <= 0 || multiplier >= 0x7FFFFFFF) {
+        return multiplier <= 0 ? 1 : ENVELOPE_UNBOUNDED_LIFETIME;
+    }
+    double samples = log((double)floor / level) / log(multiplier / 2147483648.0);
+    return samples < ENVELOPE_UNBOUNDED_LIFETIME ? (uint32_t)samples + 1 : ENVELOPE_UNBOUNDED_LIFETIME;
+}
+
+// Level after `samples` exponential steps, evaluated in closed form (iterated truncation aside)
+static double exponential_level_after(int32_t level, int32_t multiplier, uint32_t samples) {
+    return level * pow(multiplier / 2147483648.0, (double)samples);
+}
+
+bool envelope_fast_forward(const instrument_t* instrument, envelope_state_t* state, uint32_t samples_elapsed,
+                           uint32_t release_offset) {
+    if (!instrument || !instrument->envelope || samples_elapsed == 0) {
+        return true;
+    }
+
+    if (instrument->envelope == pluck_envelope) {
+        pluck_decay_t* pluck = &state->pluck;
+        double level = exponential_level_after(pluck->current_level, pluck->decay_multiplier, samples_elapsed);
+        pluck->current_level = (int32_t)level;
+        return level >= AUDIBLE_THRESHOLD;
+    }
+
+    if (instrument->envelope == adsr_envelope) {
+        adsr_t* adsr = &state->adsr;
+        if (adsr->release_coeff == 0) {
+            return false; // Hand-built state without its precomputed coefficient: not resumed
+        }
+
+        // Attack, decay and sustain are stateless: evaluate the last elapsed sample directly
+        if (samples_elapsed <= release_offset) {
+            adsr_envelope(adsr, samples_elapsed - 1, 1);
+            return true;
+        }
+
+        if (release_offset > 0) {
+            adsr_envelope(adsr, release_offset - 1, 1);
+        }
+        adsr->release_start_level = adsr->current_level;
+        adsr->phase = ADSR_RELEASE;
+
+        double level = exponential_level_after(adsr->current_level, adsr->release_coeff,
+                                               samples_elapsed - release_offset);
+        adsr->current_level = level < AUDIBLE_THRESHOLD / 4 ? 0 : (int32_t)level;
+        return adsr->current_level != 0;
+    }
+
+    // Custom envelopes could only be replayed sample by sample, too slow for the audio thread
+    return false;
+}
+
+uint32_t envelope_tail_samples(const instrument_t* instrument, const envelope_state_t* state) {
+    if (!instrument || !instrument->envelope) {
+        return ENVELOPE_UNBOUNDED_LIFETIME; // Full volume, never decays
+    }
+
+    if (instrument->envelope == pluck_envelope) {
+        const pluck_decay_t* pluck = &state->pluck;
+        return exponential_samples_until(pluck->current_level, pluck->decay_multiplier, AUDIBLE_THRESHOLD);
+    }
+
+    if (instrument->envelope == adsr_envelope) {
+        const adsr_t* adsr = &state->adsr;
+        int32_t coeff = adsr->release_coeff;
+        if (coeff == 0) {
+            coeff = adsr_release_coeff(adsr->release_samples, adsr->min_release_samples);
+        }
+        return exponential_samples_until(0x7FFFFFFF, coeff, AUDIBLE_THRESHOLD / 4);
+    }
+
+    return ENVELOPE_UNBOUNDED_LIFETIME;
+}
+
 // ============================================================================
 // STANDARD INSTRUMENT DEFINITIONS
 // ============================================================================
@@ -105,6 +316,25 @@ const instrument_t pluck_square_instrument = {.envelope = pluck_envelope,
                                               .harmonic_ratios = {1.0f, 3.0f, 5.0f},
                                               .partial_amplitudes = {1.0f, 0.333f, 0.2f}};
 
+// Wavetable instruments: a single full-scale fundamental partial drives the table
+const instrument_t saw_instrument = {.envelope = adsr_envelope,
+                                     .num_partials = 1,
+                                     .harmonic_ratios = {1.0f},
+                                     .partial_amplitudes = {1.0f},
+                                     .waveform = WAVEFORM_SAW};
+
+const instrument_t square_instrument = {.envelope = adsr_envelope,
+                                        .num_partials = 1,
+                                        .harmonic_ratios = {1.0f},
+                                        .partial_amplitudes = {1.0f},
+                                        .waveform = WAVEFORM_SQUARE};
+
+const instrument_t triangle_instrument = {.envelope = adsr_envelope,
+                                          .num_partials = 1,
+                                          .harmonic_ratios = {1.0f},
+                                          .partial_amplitudes = {1.0f},
+                                          .waveform = WAVEFORM_TRIANGLE};
+
 // ============================================================================
 // INSTRUMENT REGISTRY AND LOOKUP
 // ============================================================================
@@ -114,12 +344,17 @@ static const struct {
     const char* name;
     const instrument_t* instrument;
 } available_instruments[] = {
-    {"pluck sine", &pluck_sine_instrument}, {"pluck square", &pluck_square_instrument}, {NULL, NULL} // Sentinel
+    {"pluck sine", &pluck_sine_instrument},
+    {"pluck square", &pluck_square_instrument},
+    {"saw", &saw_instrument},
+    {"square", &square_instrument},
+    {"triangle", &triangle_instrument},
+    {NULL, NULL} // Sentinel
 };
 
-const instrument_t* lookup_instrument(const char* name) {
+const instrument_t* find_instrument(const char* name) {
     if (!name) {
-        return &pluck_sine_instrument; // Default fallback
+        return NULL;
     }
 
     for (int i = 0; available_instruments[i].name != NULL; i++) {
@@ -127,6 +362,109 @@ const instrument_t* lookup_instrument(const char* name) {
             return available_instruments[i].instrument;
         }
     }
+    return NULL;
+}
 
-    return &pluck_sine_instrument; // Default fallback
+const instrument_t* lookup_instrument(const char* name) {
+    const instrument_t* instrument = find_instrument(name);
+    return instrument ? instrument : &pluck_sine_instrument; // Default fallback
+}
+
+// Indexed by instrument_id_t
+static const instrument_t* const instruments_by_id[NUM_INSTRUMENT_IDS] = {
+    [INSTRUMENT_ID_ADSR] = &adsr_instrument,
+    [INSTRUMENT_ID_PLUCK_SINE] = &pluck_sine_instrument,
+    [INSTRUMENT_ID_PLUCK_SQUARE] = &pluck_square_instrument,
+    [INSTRUMENT_ID_SAW] = &saw_instrument,
+    [INSTRUMENT_ID_SQUARE] = &square_instrument,
+    [INSTRUMENT_ID_TRIANGLE] = &triangle_instrument,
+};
+
+instrument_id_t instrument_to_id(const instrument_t* instrument) {
+    for (int id = 0; id < NUM_INSTRUMENT_IDS; id++) {
+        if (instruments_by_id[id] == instrument) {
+            return (instrument_id_t)id;
+        }
+    }
+    return INSTRUMENT_ID_NONE;
+}
+
+const instrument_t* instrument_from_id(instrument_id_t id) {
+    return (unsigned)id < NUM_INSTRUMENT_IDS ? instruments_by_id[id] : NULL;
+}
+
+// ============================================================================
+// PARTIAL TABLE CACHE
+// ============================================================================
+
+static struct {
+    const instrument_t* instrument;
+    partial_table_t table;
+} partial_table_cache[MAX_CACHED_INSTRUMENTS];
+static atomic_int num_cached_tables = 0; // Entries below it are complete and never change
+static pthread_mutex_t partial_table_lock = PTHREAD_MUTEX_INITIALIZER; // Serializes builders, not lookups
+
+// Fundamental only, used for instruments without partials (or when the cache is full)
+static const partial_table_t fundamental_table = {.num_partials = 1, .ratio_q16 = {0x10000}, .amplitude = {0x7FFFFFFF}};
+
+static void build_partial_table(const instrument_t* instrument, partial_table_t* table) {
+    int num_partials = instrument->num_partials < MAX_PARTIALS ? instrument->num_partials : MAX_PARTIALS;
+
+    // Scale down so that the summed partials cannot overflow Q1.31
+    float total_amplitude = 0.0f;
+    for (int i = 0; i < num_partials; i++) {
+        total_amplitude += fabsf(instrument->partial_amplitudes[i]);
+    }
+    float normalize = total_amplitude > 1.0f ? 1.0f / total_amplitude : 1.0f;
+
+    table->num_partials = 0;
+    for (int i = 0; i < num_partials; i++) {
+        float ratio = instrument->harmonic_ratios[i];
+        if (ratio <= 0.0f || ratio >= 65536.0f) {
+            continue; // Not representable in Q16.16
+        }
+
+        float amplitude = instrument->partial_amplitudes[i] * normalize;
+        table->ratio_q16[table->num_partials] = (uint32_t)lroundf(ratio * 65536.0f);
+        table->amplitude[table->num_partials] = amplitude >= 1.0f ? 0x7FFFFFFF : (int32_t)(amplitude * 0x7FFFFFFF);
+        table->num_partials++;
+    }
+}
+
+const partial_table_t* instrument_partial_table(const instrument_t* instrument) {
+    if (!instrument || instrument->num_partials == 0) {
+        return &fundamental_table;
+    }
+
+    int count = atomic_load_explicit(&num_cached_tables, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (partial_table_cache[i].instrument == instrument) {
+            return &partial_table_cache[i].table;
+        }
+    }
+
+    // Miss: build under the lock, after checking the entries another builder added meanwhile.
+    // The entry is published only once it is built, so concurrent lookups never see a partial table.
+    pthread_mutex_lock(&partial_table_lock);
+    const partial_table_t* table = NULL;
+    int built = atomic_load_explicit(&num_cached_tables, memory_order_relaxed);
+    for (int i = count; i < built; i++) {
+        if (partial_table_cache[i].instrument == instrument) {
+            table = &partial_table_cache[i].table;
+        }
+    }
+    if (!table && built < MAX_CACHED_INSTRUMENTS) {
+        partial_table_cache[built].instrument = instrument;
+        build_partial_table(instrument, &partial_table_cache[built].table);
+        atomic_store_explicit(&num_cached_tables, built + 1, memory_order_release);
+        table = &partial_table_cache[built].table;
+    }
+    pthread_mutex_unlock(&partial_table_lock);
+    return table ? table : &fundamental_table;
+}
+
+void instrument_init(void) {
+    for (int id = 0; id < NUM_INSTRUMENT_IDS; id++) {
+        instrument_partial_table(instruments_by_id[id]);
+    }
 }
@@ -1,7 +1,10 @@
 #ifndef INSTRUMENT_H
 #define INSTRUMENT_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "oscillator.h"
 
 // ============================================================================
 // ENVELOPE SYSTEM
@@ -21,7 +24,7 @@ typedef struct {
 typedef struct {
     uint32_t attack_samples; // Number of samples for attack phase
     uint32_t decay_samples; // Number of samples for decay phase
-    int32_t sustain_level; // Q1.31 sustain amplitude level
+    int32_t sustain_level; // Q1.31 sustain amplitude level, never negative
     uint32_t release_samples; // Number of samples for release phase
     int32_t current_level; // Q1.31 current amplitude
     int32_t release_start_level; // Q1.31 level when release phase began
@@ -60,8 +63,16 @@ typedef struct {
     uint8_t num_partials;
     float harmonic_ratios[MAX_PARTIALS]; // For setup time
     float partial_amplitudes[MAX_PARTIALS]; // For setup time
+    waveform_t waveform; // Band-limited wavetable instead of the partials (WAVEFORM_NONE = additive)
 } instrument_t;
 
+// Fixed-point partial table, converted once per instrument and shared by all its events
+typedef struct {
+    uint8_t num_partials;
+    uint32_t ratio_q16[MAX_PARTIALS]; // Harmonic ratio in Q16.16
+    int32_t amplitude[MAX_PARTIALS]; // Q1.31, normalized so the partials never sum above full scale
+} partial_table_t;
+
 // ============================================================================
 // STANDARD INSTRUMENTS
 // ============================================================================
@@ -73,6 +84,11 @@ extern const instrument_t adsr_instrument;
 extern const instrument_t pluck_sine_instrument;
 extern const instrument_t pluck_square_instrument;
 
+// Band-limited wavetable instruments (one table read per sample regardless of brightness)
+extern const instrument_t saw_instrument;
+extern const instrument_t square_instrument;
+extern const instrument_t triangle_instrument;
+
 // ============================================================================
 // ENVELOPE FUNCTIONS
 // ============================================================================
@@ -83,11 +99,57 @@ int32_t pluck_envelope(void* state, uint32_t samples_since_start, int32_t sample
 // ADSR envelope with anti-click exponential release
 int32_t adsr_envelope(void* state, uint32_t samples_since_start, int32_t samples_until_release);
 
+// Q1.31 per-sample release multiplier for an ADSR (precomputed at sequence time)
+int32_t adsr_release_coeff(uint32_t release_samples, uint32_t min_release_samples);
+
 // ============================================================================
 // INSTRUMENT LOOKUP
 // ============================================================================
 
 // Lookup instrument by name (case-insensitive)
 const instrument_t* lookup_instrument(const char* name);
+const instrument_t* find_instrument(const char* name); // Like lookup_instrument, but NULL if unknown
+
+// Stable numeric instrument IDs for serialized scores (never renumber, only append)
+typedef enum {
+    INSTRUMENT_ID_ADSR = 0,
+    INSTRUMENT_ID_PLUCK_SINE = 1,
+    INSTRUMENT_ID_PLUCK_SQUARE = 2,
+    INSTRUMENT_ID_SAW = 3,
+    INSTRUMENT_ID_SQUARE = 4,
+    INSTRUMENT_ID_TRIANGLE = 5,
+    NUM_INSTRUMENT_IDS,
+    INSTRUMENT_ID_NONE = 0xFFFF, // No instrument (full-volume fundamental)
+} instrument_id_t;
+
+instrument_id_t instrument_to_id(const instrument_t* instrument); // INSTRUMENT_ID_NONE if unknown
+const instrument_t* instrument_from_id(instrument_id_t id); // NULL for INSTRUMENT_ID_NONE or unknown
+
+// Evaluate an instrument's envelope for num_samples consecutive samples into levels[], returning
+// the last level. Built-in envelopes are computed per segment without per-sample calls. The
+// block must lie entirely before or entirely after the release point.
+int32_t envelope_render_block(const instrument_t* instrument, envelope_state_t* state, uint32_t samples_since_start,
+                              int32_t samples_until_release, int32_t* levels, size_t num_samples);
+
+// Seeking: advance an envelope as if samples [0, samples_elapsed) had been rendered with the release
+// at release_offset, in closed form. Returns false if it has died out, and for custom envelopes
+// (which are not resumed).
+bool envelope_fast_forward(const instrument_t* instrument, envelope_state_t* state, uint32_t samples_elapsed,
+                           uint32_t release_offset);
+
+#define ENVELOPE_UNBOUNDED_LIFETIME 0x40000000u // Tail of custom (or no) envelopes: no known end
+
+// Upper bound on how long an envelope stays audible after its release point (from the start for
+// envelopes that ignore the release, e.g. pluck)
+uint32_t envelope_tail_samples(const instrument_t* instrument, const envelope_state_t* state);
+
+// Get the cached fixed-point partial table for an instrument. Lookups are lock-free and safe from
+// any thread; a table missing from the cache is built by the caller under a lock, so the audio
+// thread must only look up instruments built beforehand.
+const partial_table_t* instrument_partial_table(const instrument_t* instrument);
+
+// Build the partial tables of every built-in instrument, so the audio thread only ever looks
+// them up (called by music_init)
+void instrument_init(void);
 
 #endif // INSTRUMENT_H
@@ -0,0 +1,145 @@
+#include "lookahead.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rt_stats.h"
+
+// ============================================================================
+// RENDER THREAD
+// ============================================================================
+
+// A full ring is polled rather than signalled, so the audio thread never makes a
+// syscall; half a quantum of sleep keeps the refill well ahead of the reader.
+static void sleep_half_quantum(const lookahead_t* la) {
+    uint64_t ns = (uint64_t)la->quantum * 500000000ull / la->format.sample_rate;
+    struct timespec ts = {.tv_sec = (time_t)(ns / 1000000000ull), .tv_nsec = (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+// Render one quantum if there is room, returns false when the ring is full
+static bool render_ahead(lookahead_t* la) {
+    uint64_t write = atomic_load_explicit(&la->write_pos, memory_order_relaxed);
+    uint64_t read = atomic_load_explicit(&la->read_pos, memory_order_acquire);
+    if (la->capacity - (size_t)(write - read) < la->quantum) {
+        return false;
+    }
+
+    uint8_t* dst = la->ring + (size_t)(write % la->capacity) * la->frame_size;
+    bool more = la->callback(dst, la->quantum, &la->format, la->user_data);
+
+    // Publish the frames before the end-of-song flag, so a reader that sees the flag sees them too
+    atomic_store_explicit(&la->write_pos, write + la->quantum, memory_order_release);
+    if (!more) {
+        atomic_store_explicit(&la->finished, true, memory_order_release);
+    }
+    return true;
+}
+
+static void* render_main(void* arg) {
+    lookahead_t* la = arg;
+
+    while (!atomic_load_explicit(&la->quit, memory_order_acquire) &&
+           !atomic_load_explicit(&la->finished, memory_order_relaxed)) {
+        if (!render_ahead(la)) {
+            sleep_half_quantum(la);
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// AUDIO THREAD
+// ============================================================================
+
+bool lookahead_callback(void* buffer, size_t num_frames, const audio_format_t* format, void* user_data) {
+    lookahead_t* la = user_data;
+    (void)format; // Fixed at creation, the driver was initialized with the same one
+    uint8_t* out = buffer;
+
+    // Load the flag first: if it is set, write_pos below is already final
+    bool finished = atomic_load_explicit(&la->finished, memory_order_acquire);
+    uint64_t write = atomic_load_explicit(&la->write_pos, memory_order_acquire);
+    uint64_t read = atomic_load_explicit(&la->read_pos, memory_order_relaxed);
+
+    size_t available = (size_t)(write - read);
+    size_t n = available < num_frames ? available : num_frames;
+
+    // Up to two copies around the end of the ring
+    size_t offset = (size_t)(read % la->capacity);
+    size_t first = la->capacity - offset < n ? la->capacity - offset : n;
+    memcpy(out, la->ring + offset * la->frame_size, first * la->frame_size);
+    memcpy(out + first * la->frame_size, la->ring, (n - first) * la->frame_size);
+
+    if (n < num_frames) {
+        memset(out + n * la->frame_size, 0, (num_frames - n) * la->frame_size);
+        if (!finished) {
+            RT_STATS_UNDERRUN();
+        }
+    }
+
+    atomic_store_explicit(&la->read_pos, read + n, memory_order_release);
+    return !(finished && n == available); // Done once the final frames have been handed out
+}
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+lookahead_t* lookahead_create(const audio_format_t* format, audio_callback_t callback, size_t quantum_frames,
+                              int quanta) {
+    if (!format || !callback || format->sample_rate == 0 || quantum_frames == 0 || quanta < 1 ||
+        quanta > LOOKAHEAD_MAX_QUANTA) {
+        return NULL;
+    }
+
+    lookahead_t* la = calloc(1, sizeof(lookahead_t));
+    if (!la) {
+        return NULL;
+    }
+
+    la->callback = callback;
+    la->format = *format;
+    la->frame_size = audio_frame_size(format);
+    la->quantum = quantum_frames;
+    la->capacity = quantum_frames * (size_t)quanta;
+    la->ring = calloc(la->capacity, la->frame_size);
+    if (!la->ring) {
+        free(la);
+        return NULL;
+    }
+
+    atomic_init(&la->write_pos, 0);
+    atomic_init(&la->read_pos, 0);
+    atomic_init(&la->finished, false);
+    atomic_init(&la->quit, false);
+    return la;
+}
+
+bool lookahead_start(lookahead_t* la, void* user_data) {
+    if (la->running) {
+        return false;
+    }
+    la->user_data = user_data;
+
+    // Prime the ring on this thread so playback starts with the full lookahead
+    while (!atomic_load_explicit(&la->finished, memory_order_relaxed) && render_ahead(la)) {
+    }
+
+    if (pthread_create(&la->thread, NULL, render_main, la) != 0) {
+        return false;
+    }
+    la->running = true;
+    return true;
+}
+
+void lookahead_cleanup(lookahead_t* la) {
+    if (!la)
+        return;
+
+    if (la->running) {
+        atomic_store_explicit(&la->quit, true, memory_order_release);
+        pthread_join(la->thread, NULL);
+    }
+    free(la->ring);
+    free(la);
+}
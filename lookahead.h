@@ -0,0 +1,59 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_driver.h"
+
+// ============================================================================
+// LOOKAHEAD PRE-RENDER
+// ============================================================================
+
+// Pipelined playback: a render thread runs the real audio callback a fixed number
+// of quanta ahead into a single-producer/single-consumer ring of output frames,
+// and lookahead_callback (called by the driver's real-time thread) only copies
+// frames out. A render spike now has to outlast the whole lookahead before it
+// is heard, at the cost of that much extra latency. Live sequencer commands are
+// still applied at block boundaries, just by the render thread, so they take
+// effect up to one lookahead later.
+
+#define LOOKAHEAD_MAX_QUANTA 64
+
+typedef struct {
+    audio_callback_t callback; // Real callback, run on the render thread
+    void* user_data;
+    audio_format_t format;
+    size_t frame_size; // Bytes per interleaved frame
+    size_t quantum; // Frames per render call
+    size_t capacity; // Ring size in frames (a whole number of quanta, so a render never wraps)
+    uint8_t* ring;
+
+    // Monotonic frame counters: the render thread owns write_pos, the audio thread read_pos
+    _Atomic uint64_t write_pos;
+    _Atomic uint64_t read_pos;
+    atomic_bool finished; // Callback returned false; write_pos is final
+    atomic_bool quit;
+
+    pthread_t thread;
+    bool running;
+} lookahead_t;
+
+// Ring of `quanta` quanta of `quantum_frames` each for the callback's output format.
+// Returns NULL on failure.
+lookahead_t* lookahead_create(const audio_format_t* format, audio_callback_t callback, size_t quantum_frames,
+                              int quanta);
+
+// Start the render thread on user_data and block until the ring is full (or the song ended)
+bool lookahead_start(lookahead_t* la, void* user_data);
+
+// Audio callback copying pre-rendered frames (pass the lookahead_t as user_data). Plays silence
+// and counts an underrun when the ring runs dry; returns false once the song is fully played.
+bool lookahead_callback(void* buffer, size_t num_frames, const audio_format_t* format, void* user_data);
+
+// Stop the render thread and free the ring
+void lookahead_cleanup(lookahead_t* la);
+
+#endif // LOOKAHEAD_H
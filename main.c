@@ -1,45 +1,352 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "audio_driver.h"
-#include "pw_driver.h"
+#include "file_driver.h"
+#include "lookahead.h"
+#include "rt_log.h"
+#include "rt_stats.h"
+#include "score_file.h"
 #include "sequencer.h"
 #include "test.h"
 
-int main() {
-    printf("Initializing simple audio test...\n");
+// Playback backends compiled in (the CMake options set these)
+#ifndef MUSICBOX_PIPEWIRE
+#define MUSICBOX_PIPEWIRE 1
+#endif
+#ifndef MUSICBOX_ALSA
+#define MUSICBOX_ALSA 0
+#endif
+#ifndef MUSICBOX_NULL_DRIVER
+#define MUSICBOX_NULL_DRIVER 1
+#endif
 
-    // Setup signal handling
-    pw_driver_setup_signals();
+#if MUSICBOX_PIPEWIRE
+#include "pw_driver.h"
+#endif
+#if MUSICBOX_ALSA
+#include "alsa_driver.h"
+#endif
+#if MUSICBOX_NULL_DRIVER
+#include "null_driver.h"
+#endif
 
-    // Initialize musicbox system
-    music_init();
+#define SAMPLE_RATE 44100 // Offline rendering and compiling; playback runs at the device's own rate
+#define PLAYBACK_CHANNELS 2 // Desktop graphs mix in stereo F32, so matching it skips their conversion
+#define FILE_CHANNELS 1
+#define LOOKAHEAD_QUANTUM 256 // Frames per pre-rendered quantum with -a
+
+// Output format overrides from the command line (0 / -1 = the sink's default)
+static uint32_t channels_option = 0;
+static int format_option = -1;
+static int lookahead_option = 0; // Quanta to pre-render on a separate thread (0 = render in the callback)
+static uint32_t period_option = 0; // Frames per period for ALSA / null playback (0 = the backend's default)
+static uint32_t rate_option = 0; // Sample rate to sequence and render at (0 = SAMPLE_RATE offline, native for playback)
+static int budget_option = 0; // Percent of each quantum's playback time rendering may take before culling (0 = off)
+
+// A real-time playback backend: its driver vtable plus the blocking loop that runs it
+typedef struct {
+    const char* name;
+    const audio_driver_t* driver;
+    void (*setup_signals)(void);
+    void (*run)(void* context);
+    void (*configure)(void); // Apply command line options before init, may be NULL
+} playback_backend_t;
+
+#if MUSICBOX_ALSA
+static void configure_alsa(void) { alsa_driver_configure(NULL, period_option, 0); }
+#endif
+#if MUSICBOX_NULL_DRIVER
+static void configure_null(void) { null_driver_configure(period_option); }
+#endif
+
+// The first entry is the default, a NULL name ends the table
+static const playback_backend_t playback_backends[] = {
+#if MUSICBOX_PIPEWIRE
+    {"pipewire", &pipewire_driver, pw_driver_setup_signals, pw_driver_run_main_loop, NULL},
+#endif
+#if MUSICBOX_ALSA
+    {"alsa", &alsa_driver, alsa_driver_setup_signals, alsa_driver_run, configure_alsa},
+#endif
+#if MUSICBOX_NULL_DRIVER
+    {"null", &null_driver, null_driver_setup_signals, null_driver_run, configure_null},
+#endif
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static const playback_backend_t* find_backend(const char* name) {
+    for (size_t i = 0; playback_backends[i].name; i++) {
+        if (strcmp(playback_backends[i].name, name) == 0) {
+            return &playback_backends[i];
+        }
+    }
+    return NULL;
+}
+
+static audio_format_t output_format(uint32_t sample_rate, uint32_t channels, audio_sample_format_t format) {
+    audio_format_t out = {
+        .sample_rate = sample_rate,
+        .channels = channels_option ? channels_option : channels,
+        .format = format_option >= 0 ? (audio_sample_format_t)format_option : format,
+    };
+    return out;
+}
+
+static int parse_sample_format(const char* name) {
+    if (strcmp(name, "s16") == 0) return AUDIO_FORMAT_S16;
+    if (strcmp(name, "s32") == 0) return AUDIO_FORMAT_S32;
+    if (strcmp(name, "f32") == 0) return AUDIO_FORMAT_F32;
+    return -1;
+}
+
+// Play a compiled score straight from its mapping, or build the test song at sample_rate
+static sequencer_state_t* create_song(uint32_t sample_rate, const score_file_t* score) {
+    sequencer_state_t* song = score ? create_mapped_sequencer(score) : create_complex_test(sample_rate);
+    if (!song) {
+        printf("Failed to create song\n");
+    }
+    return song;
+}
+
+// Start rendering the song into a lookahead ring ahead of the real-time thread (offline rendering has
+// no deadline to protect). Returns NULL on failure.
+static lookahead_t* start_lookahead(const audio_format_t* format, sequencer_state_t* song) {
+    lookahead_t* la = lookahead_create(format, sequencer_callback, LOOKAHEAD_QUANTUM, lookahead_option);
+    if (!la || !lookahead_start(la, song)) {
+        printf("Failed to start the lookahead render thread\n");
+        lookahead_cleanup(la);
+        return NULL;
+    }
+
+    printf("Pre-rendering %d x %d frames ahead\n", lookahead_option, LOOKAHEAD_QUANTUM);
+    return la;
+}
+
+// Write the song's sequenced events as a compiled score (musicbox -c out.mbs)
+static int compile_to_file(const sequencer_state_t* song, const char* path) {
+    if (!score_file_write(path, &song->events, song->sample_rate)) {
+        printf("Failed to write %s\n", path);
+        return 1;
+    }
 
-    const audio_driver_t* driver = &pipewire_driver;
+    printf("Compiled %d events to %s\n", song->events.count, path);
+    return 0;
+}
+
+// Render the song offline as fast as possible (musicbox -o out.wav|out.raw)
+static int render_to_file(sequencer_state_t* song, const char* path) {
+    const audio_driver_t* driver = &file_driver;
+    int error;
+
+    size_t len = strlen(path);
+    file_format_t format = (len >= 4 && strcmp(path + len - 4, ".raw") == 0) ? FILE_FORMAT_RAW : FILE_FORMAT_WAV;
+
+    file_driver_setup_signals();
+
+    audio_format_t audio_format = output_format(song->sample_rate, FILE_CHANNELS, AUDIO_FORMAT_S16);
+    void* audio_ctx = driver->init(&audio_format, sequencer_callback, &error);
+    if (!audio_ctx) {
+        printf("Failed to initialize file output: %s\n", driver->strerror(error));
+        return 1;
+    }
+    if (!file_driver_open(audio_ctx, path, format)) {
+        printf("Failed to open %s\n", path);
+        driver->cleanup(audio_ctx);
+        return 1;
+    }
+
+    driver->play(audio_ctx, song);
+
+    // Blocks until the song completes or is interrupted
+    file_driver_render(audio_ctx);
+    driver->stop(audio_ctx);
+
+    file_driver_stats_t stats = file_driver_get_stats(audio_ctx);
+    printf("Rendered %lu frames to %s in %.3f s\n", (unsigned long)stats.samples_rendered, path,
+           stats.elapsed_seconds);
+    printf("Throughput: %.0f frames/sec (%.1fx real time)\n", stats.samples_per_second, stats.realtime_factor);
+    rt_stats_print();
+
+    driver->cleanup(audio_ctx);
+    return 0;
+}
+
+// Play through a real-time backend until the song completes or Ctrl+C. The song is built once the
+// backend has settled its rate, so it is sequenced at the rate the device or graph natively runs at
+// (a compiled score keeps the rate it was compiled for).
+static int play_song(const playback_backend_t* backend, const score_file_t* score) {
+    if (!backend) {
+        printf("No playback backend built in, use -o to render to a file\n");
+        return 1;
+    }
+    printf("Initializing simple audio test (%s)...\n", backend->name);
+
+    // Setup signal handling
+    backend->setup_signals();
+    if (backend->configure) {
+        backend->configure();
+    }
+
+    const audio_driver_t* driver = backend->driver;
     int error;
 
     // Initialize audio system
-    void* audio_ctx = driver->init(44100, sequencer_callback, &error);
+    uint32_t rate = score ? score->header->sample_rate : rate_option ? rate_option : AUDIO_RATE_NATIVE;
+    audio_format_t audio_format = output_format(rate, PLAYBACK_CHANNELS, AUDIO_FORMAT_F32);
+    audio_callback_t callback = lookahead_option ? lookahead_callback : sequencer_callback;
+    void* audio_ctx = driver->init(&audio_format, callback, &error);
     if (!audio_ctx) {
         printf("Failed to initialize audio: %s\n", driver->strerror(error));
         return 1;
     }
 
-    // Create test song and start playback
-    sequencer_state_t* song = create_complex_test(44100);
-    driver->play(audio_ctx, song);
+    const audio_format_t* format = driver->format(audio_ctx);
+    if (!format) {
+        printf("Audio format negotiation failed\n");
+        driver->cleanup(audio_ctx);
+        return 1;
+    }
+    printf("Output: %u Hz, %u channels\n", format->sample_rate, format->channels);
+
+    sequencer_state_t* song = NULL;
+    lookahead_t* lookahead = NULL;
+    if (rate != AUDIO_RATE_NATIVE && format->sample_rate != rate) {
+        printf("Score is at %u Hz but the output runs at %u Hz\n", rate, format->sample_rate);
+    } else if ((song = create_song(format->sample_rate, score))) {
+        if (budget_option) {
+            sequencer_set_cpu_budget(song, budget_option / 100.0f);
+        }
+        if (lookahead_option) {
+            lookahead = start_lookahead(format, song);
+        }
+    }
+    if (!song || (lookahead_option && !lookahead)) {
+        driver->cleanup(audio_ctx);
+        cleanup_sequencer_state(song);
+        return 1;
+    }
+
+    // Start playback
+    driver->play(audio_ctx, lookahead ? (void*)lookahead : (void*)song);
 
     printf("Playing test song. Press Ctrl+C to stop.\n");
     printf("Expected: Anti-click exponential ADSR notes with smooth release curves\n");
 
     // Run main loop (blocks until completion or interrupted)
-    pw_driver_run_main_loop(audio_ctx);
+    backend->run(audio_ctx);
+    rt_log_drain(); // Flush records written after the last periodic drain
 
     printf("Stopping playback...\n");
     driver->stop(audio_ctx);
 
+    if (rt_log_dropped() > 0) {
+        printf("Warning: %u real-time log records dropped\n", rt_log_dropped());
+    }
+    rt_stats_print();
+
     // Clean up
-    cleanup_sequencer_state(song);
     driver->cleanup(audio_ctx);
+    lookahead_cleanup(lookahead);
+    cleanup_sequencer_state(song);
     printf("Test complete.\n");
-
     return 0;
 }
+
+int main(int argc, char** argv) {
+    const char* output_path = NULL;
+    const char* compile_path = NULL;
+    const char* load_path = NULL;
+    const playback_backend_t* backend = playback_backends[0].name ? &playback_backends[0] : NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            compile_path = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            load_path = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1 &&
+                   atoi(argv[i + 1]) <= AUDIO_MAX_CHANNELS) {
+            channels_option = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc && parse_sample_format(argv[i + 1]) >= 0) {
+            format_option = parse_sample_format(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1 &&
+                   atoi(argv[i + 1]) <= LOOKAHEAD_MAX_QUANTA) {
+            lookahead_option = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc && find_backend(argv[i + 1])) {
+            backend = find_backend(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            period_option = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            rate_option = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1 &&
+                   atoi(argv[i + 1]) <= 100) {
+            budget_option = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [-l score.mbs | -c score.mbs] [-o output.wav|output.raw] [-n channels] "
+                   "[-f s16|s32|f32] [-r rate] [-a quanta] [-b percent] [-d backend] [-p period]\n",
+                   argv[0]);
+            printf("Defaults: %d-channel f32 at the device's rate for playback, %d-channel s16 at %d Hz for -o\n",
+                   PLAYBACK_CHANNELS, FILE_CHANNELS, SAMPLE_RATE);
+            printf("-a pre-renders up to %d quanta of %d frames on a separate thread during playback\n",
+                   LOOKAHEAD_MAX_QUANTA, LOOKAHEAD_QUANTUM);
+            printf("-b culls the quietest partials whenever rendering takes over percent of the playback time\n");
+            printf("Playback backends:");
+            for (size_t b = 0; playback_backends[b].name; b++) {
+                printf(" %s%s", playback_backends[b].name, b == 0 ? " (default)" : "");
+            }
+            printf("; -p sets the alsa/null period in frames\n");
+            return 1;
+        }
+    }
+    if ((lookahead_option || budget_option) && (output_path || compile_path)) {
+        printf("-a and -b only apply to real-time playback\n");
+        return 1;
+    }
+#if !MUSICBOX_RT_STATS
+    if (budget_option) {
+        printf("-b needs render timings, which this build leaves out (MUSICBOX_RT_STATS=OFF)\n");
+        return 1;
+    }
+#endif
+    if (load_path && compile_path) {
+        printf("A loaded score is already compiled\n");
+        return 1;
+    }
+    if (compile_path && output_path) {
+        printf("-c only compiles the score; render it with -l %s -o %s\n", compile_path, output_path);
+        return 1;
+    }
+
+    // Initialize musicbox system
+    music_init();
+
+    score_file_t score = {0};
+    if (load_path) {
+        if (!score_file_open(&score, load_path)) {
+            printf("Failed to load compiled score %s\n", load_path);
+            return 1;
+        }
+        if (rate_option && score.header->sample_rate != rate_option) {
+            printf("%s was compiled for %u Hz, expected %u Hz\n", load_path, score.header->sample_rate, rate_option);
+            score_file_close(&score);
+            return 1;
+        }
+    }
+
+    int result;
+    if (compile_path || output_path) {
+        sequencer_state_t* song = create_song(rate_option ? rate_option : SAMPLE_RATE, load_path ? &score : NULL);
+        if (!song) {
+            score_file_close(&score);
+            return 1;
+        }
+        result = compile_path ? compile_to_file(song, compile_path) : render_to_file(song, output_path);
+        cleanup_sequencer_state(song);
+    } else {
+        result = play_song(backend, load_path ? &score : NULL);
+    }
+
+    score_file_close(&score);
+    return result;
+}
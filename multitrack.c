@@ -0,0 +1,245 @@
+#include "multitrack.h"
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rt_stats.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// ============================================================================
+// WAIT AND WAKE
+// ============================================================================
+
+#define WORKER_SPIN_ITERATIONS 2000 // Spin this long for the next quantum before sleeping
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ volatile("yield");
+#endif
+}
+
+static void futex_wait(atomic_uint* word, unsigned expected) {
+#ifdef __linux__
+    syscall(SYS_futex, (unsigned*)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    (void)word;
+    (void)expected;
+    sched_yield();
+#endif
+}
+
+static void futex_wake_all(atomic_uint* word) {
+#ifdef __linux__
+    syscall(SYS_futex, (unsigned*)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+// Block until the generation moves past `seen`, returns the new generation
+static unsigned wait_for_generation(multitrack_state_t* mt, unsigned seen) {
+    for (int i = 0; i < WORKER_SPIN_ITERATIONS; i++) {
+        unsigned generation = atomic_load_explicit(&mt->generation, memory_order_acquire);
+        if (generation != seen) {
+            return generation;
+        }
+        cpu_relax();
+    }
+
+    for (;;) {
+        // Announce ourselves before re-checking, so the callback either sees a sleeper or we see its bump
+        atomic_fetch_add(&mt->sleepers, 1);
+        unsigned generation = atomic_load(&mt->generation);
+        if (generation == seen) {
+            futex_wait(&mt->generation, seen);
+            generation = atomic_load(&mt->generation);
+        }
+        atomic_fetch_sub(&mt->sleepers, 1);
+
+        if (generation != seen) {
+            return generation;
+        }
+    }
+}
+
+// ============================================================================
+// TRACK RENDERING
+// ============================================================================
+
+// Claim and render tracks until none are left in this quantum (callback and worker threads)
+static void render_claimed_tracks(multitrack_state_t* mt) {
+    int t;
+    while ((t = atomic_fetch_add_explicit(&mt->next_track, 1, memory_order_acq_rel)) < mt->num_tracks) {
+        int32_t* out = mt->track_buffers[t];
+
+        // Tracks render into their own unconverted planes (stride = quantum) for a single final conversion
+        memset(out, 0, mt->planes * mt->quantum * sizeof(int32_t));
+        if (!mt->track_finished[t] && !sequencer_render(mt->tracks[t], out, mt->quantum, mt->planes, mt->quantum)) {
+            mt->track_finished[t] = true;
+        }
+
+        atomic_fetch_add_explicit(&mt->tracks_done, 1, memory_order_release);
+    }
+}
+
+static void* worker_main(void* arg) {
+    multitrack_state_t* mt = arg;
+    unsigned seen = atomic_load(&mt->generation);
+
+    for (;;) {
+        seen = wait_for_generation(mt, seen);
+        if (atomic_load_explicit(&mt->quit, memory_order_acquire)) {
+            break;
+        }
+        render_claimed_tracks(mt);
+    }
+
+    return NULL;
+}
+
+// Render one quantum of every track in parallel and wait for all of them
+static void render_quantum(multitrack_state_t* mt, size_t num_samples, int planes) {
+    mt->quantum = num_samples;
+    mt->planes = planes;
+    atomic_store_explicit(&mt->tracks_done, 0, memory_order_relaxed);
+    atomic_store_explicit(&mt->next_track, 0, memory_order_release);
+
+    if (mt->num_workers > 0) {
+        atomic_fetch_add(&mt->generation, 1);
+        if (atomic_load(&mt->sleepers) > 0) {
+            futex_wake_all(&mt->generation);
+        }
+    }
+
+    render_claimed_tracks(mt);
+
+    // Yield once spinning has gone on too long, in case a worker was preempted on this core
+    int spins = 0;
+    while (atomic_load_explicit(&mt->tracks_done, memory_order_acquire) < mt->num_tracks) {
+        if (++spins < WORKER_SPIN_ITERATIONS) {
+            cpu_relax();
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+// ============================================================================
+// MULTI-TRACK CALLBACK
+// ============================================================================
+
+bool multitrack_callback(void* buffer, size_t num_frames, const audio_format_t* format, void* user_data) {
+    multitrack_state_t* mt = (multitrack_state_t*)user_data;
+    int planes = format->channels > 1 ? MIX_BUS_PLANES : 1;
+    size_t pos = 0;
+    int peak_voices = 0;
+
+    while (pos < num_frames) {
+        size_t chunk = num_frames - pos;
+        if (chunk > MULTITRACK_MAX_QUANTUM) {
+            chunk = MULTITRACK_MAX_QUANTUM;
+        }
+
+        render_quantum(mt, chunk, planes);
+
+        int voices = 0;
+        for (int t = 0; t < mt->num_tracks; t++) {
+            voices += mt->tracks[t]->peak_voices;
+        }
+        if (voices > peak_voices) {
+            peak_voices = voices;
+        }
+
+        // Sum the tracks at full int32 precision; saturation happens once, in the final conversion
+        size_t bus_samples = planes * chunk;
+        memcpy(mt->mix_bus, mt->track_buffers[0], bus_samples * sizeof(int32_t));
+        for (int t = 1; t < mt->num_tracks; t++) {
+            for (size_t i = 0; i < bus_samples; i++) {
+                mt->mix_bus[i] += mt->track_buffers[t][i];
+            }
+        }
+        mix_bus_convert(mt->mix_bus, chunk, planes, chunk, format, buffer, pos);
+
+        pos += chunk;
+    }
+    RT_STATS_VOICES(peak_voices);
+
+    for (int t = 0; t < mt->num_tracks; t++) {
+        if (!mt->track_finished[t]) {
+            return true; // Continue playback
+        }
+    }
+
+    mt->completed = true;
+    return false; // Every track has finished
+}
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+static void stop_workers(multitrack_state_t* mt) {
+    atomic_store_explicit(&mt->quit, true, memory_order_release);
+    atomic_fetch_add(&mt->generation, 1);
+    futex_wake_all(&mt->generation);
+
+    for (int i = 0; i < mt->num_workers; i++) {
+        pthread_join(mt->workers[i], NULL);
+    }
+    mt->num_workers = 0;
+}
+
+multitrack_state_t* create_multitrack_state(sequencer_state_t** tracks, int num_tracks, int num_workers) {
+    if (!tracks || num_tracks <= 0 || num_tracks > MAX_TRACKS) {
+        return NULL;
+    }
+
+    multitrack_state_t* mt = calloc(1, sizeof(multitrack_state_t));
+    if (!mt) {
+        return NULL;
+    }
+
+    for (int t = 0; t < num_tracks; t++) {
+        mt->tracks[t] = tracks[t];
+    }
+    mt->num_tracks = num_tracks;
+
+    // The callback thread renders too, so more workers than tracks - 1 or cores - 1 would only idle
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && num_workers > cpus - 1) {
+        num_workers = (int)(cpus - 1);
+    }
+    if (num_workers > num_tracks - 1) {
+        num_workers = num_tracks - 1;
+    }
+    if (num_workers > MAX_WORKERS) {
+        num_workers = MAX_WORKERS;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&mt->workers[i], NULL, worker_main, mt) != 0) {
+            break; // Run with the workers we have
+        }
+        mt->num_workers++;
+    }
+
+    return mt;
+}
+
+void cleanup_multitrack_state(multitrack_state_t* mt) {
+    if (!mt)
+        return;
+
+    stop_workers(mt);
+    for (int t = 0; t < mt->num_tracks; t++) {
+        cleanup_sequencer_state(mt->tracks[t]);
+    }
+    free(mt);
+}
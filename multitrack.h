@@ -0,0 +1,58 @@
+#ifndef MULTITRACK_H
+#define MULTITRACK_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sequencer.h"
+
+// ============================================================================
+// MULTI-TRACK TYPES
+// ============================================================================
+
+#define MAX_TRACKS 16
+#define MAX_WORKERS 8
+#define MULTITRACK_MAX_QUANTUM 1024 // Larger requests are rendered in chunks of this size
+
+// Independent sequencers rendered in parallel each quantum and mixed on the callback thread.
+// Workers are spawned up front; per quantum the callback publishes a new generation, wakes
+// sleeping workers (futex) and renders tracks itself alongside them. Nothing is allocated
+// after creation.
+typedef struct {
+    sequencer_state_t* tracks[MAX_TRACKS];
+    bool track_finished[MAX_TRACKS];
+    int32_t track_buffers[MAX_TRACKS][MIX_BUS_PLANES * MULTITRACK_MAX_QUANTUM]; // Unconverted mix planes
+    int32_t mix_bus[MIX_BUS_PLANES * MULTITRACK_MAX_QUANTUM]; // Sum of all tracks
+    int num_tracks;
+
+    // === Worker Pool ===
+    pthread_t workers[MAX_WORKERS];
+    int num_workers;
+    atomic_uint generation; // Bumped by the callback thread once per quantum (futex word)
+    atomic_int sleepers; // Workers blocked in the futex
+    atomic_int next_track; // Next track to claim in the current quantum
+    atomic_int tracks_done; // Tracks rendered in the current quantum
+    atomic_bool quit;
+    size_t quantum; // Samples to render in the current quantum
+    int planes; // Mix planes rendered in the current quantum
+
+    bool completed; // Set by callback when every track has finished
+} multitrack_state_t;
+
+// ============================================================================
+// MULTI-TRACK FUNCTIONS
+// ============================================================================
+
+// Create a multi-track player taking ownership of the tracks, with num_workers helper threads
+// (0 renders every track on the callback thread). Returns NULL on failure.
+multitrack_state_t* create_multitrack_state(sequencer_state_t** tracks, int num_tracks, int num_workers);
+
+// Audio callback rendering and mixing all tracks (pass the multitrack_state_t as user_data)
+bool multitrack_callback(void* buffer, size_t num_frames, const audio_format_t* format, void* user_data);
+
+// Stop the workers and free the player and its tracks
+void cleanup_multitrack_state(multitrack_state_t* mt);
+
+#endif // MULTITRACK_H
@@ -0,0 +1,183 @@
+#include "null_driver.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "rt_log.h"
+#include "rt_stats.h"
+
+// ============================================================================
+// NULL DRIVER TYPES
+// ============================================================================
+
+typedef struct {
+    audio_format_t format;
+    audio_callback_t callback;
+    void *user_data;
+    atomic_bool playing;
+    uint32_t period_frames;
+    uint8_t *buffer; // One period, rendered into and discarded
+} null_audio_context_t;
+
+enum {
+    NULL_ERROR_NONE,
+    NULL_ERROR_ALLOC,
+    NULL_ERROR_FORMAT,
+};
+
+// ============================================================================
+// NULL DRIVER GLOBAL STATE
+// ============================================================================
+
+static volatile sig_atomic_t interrupted = 0;
+static uint32_t config_period_frames = NULL_DEFAULT_PERIOD_FRAMES;
+
+static void signal_handler(int sig) {
+    (void)sig;  // Unused parameter
+    interrupted = 1;
+}
+
+void null_driver_setup_signals(void) {
+    signal(SIGINT, signal_handler);
+}
+
+void null_driver_configure(uint32_t period_frames) {
+    if (period_frames == 0) {
+        period_frames = NULL_DEFAULT_PERIOD_FRAMES;
+    }
+    config_period_frames = period_frames < NULL_MAX_PERIOD_FRAMES ? period_frames : NULL_MAX_PERIOD_FRAMES;
+}
+
+// ============================================================================
+// NULL DRIVER IMPLEMENTATION
+// ============================================================================
+
+static void add_ns(struct timespec *ts, uint64_t ns) {
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000ull);
+    ts->tv_nsec = (long)(ns % 1000000000ull);
+}
+
+static bool is_before(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+void null_driver_run(void *context) {
+    null_audio_context_t *ctx = context;
+    uint64_t period_ns = (uint64_t)ctx->period_frames * 1000000000ull / ctx->format.sample_rate;
+
+    // Absolute deadlines, so render time and wakeup jitter do not accumulate into drift
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (atomic_load_explicit(&ctx->playing, memory_order_acquire) && ctx->callback && !interrupted) {
+        uint64_t render_start = RT_STATS_NOW();
+        bool continue_playing = ctx->callback(ctx->buffer, ctx->period_frames, &ctx->format, ctx->user_data);
+        RT_STATS_QUANTUM(ctx->period_frames, ctx->format.sample_rate, RT_STATS_NOW() - render_start);
+        rt_log_drain();
+
+        if (!continue_playing) {
+            atomic_store_explicit(&ctx->playing, false, memory_order_release);
+            ctx->user_data = NULL;  // Callback finished the song
+            break;
+        }
+
+        // A device would have played the period by now: if we are already past the next deadline
+        // it ran dry, so count it and restart the clock instead of rushing to catch up
+        add_ns(&deadline, period_ns);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (is_before(&deadline, &now)) {
+            RT_STATS_UNDERRUN();
+            deadline = now;
+            continue;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !interrupted) {
+        }
+    }
+}
+
+static void* null_init(const audio_format_t *format, audio_callback_t callback, int *error) {
+    if (format->channels < 1 || format->channels > AUDIO_MAX_CHANNELS) {
+        *error = NULL_ERROR_FORMAT;
+        return NULL;
+    }
+
+    null_audio_context_t *ctx = calloc(1, sizeof(null_audio_context_t));
+    if (!ctx) {
+        *error = NULL_ERROR_ALLOC;
+        return NULL;
+    }
+
+    ctx->format = *format;
+    if (ctx->format.sample_rate == AUDIO_RATE_NATIVE) {
+        ctx->format.sample_rate = NULL_NATIVE_RATE;
+    }
+    ctx->callback = callback;
+    ctx->period_frames = config_period_frames;
+    atomic_init(&ctx->playing, false);
+
+    ctx->buffer = malloc(ctx->period_frames * audio_frame_size(format));
+    if (!ctx->buffer) {
+        free(ctx);
+        *error = NULL_ERROR_ALLOC;
+        return NULL;
+    }
+
+    *error = NULL_ERROR_NONE;
+    return ctx;
+}
+
+static void null_play(void *context, void *user_data) {
+    null_audio_context_t *ctx = context;
+    ctx->user_data = user_data;
+    atomic_store_explicit(&ctx->playing, true, memory_order_release);
+    printf("Started null playback (%u-frame periods)\n", ctx->period_frames);
+}
+
+static void null_stop(void *context) {
+    null_audio_context_t *ctx = context;
+    atomic_store_explicit(&ctx->playing, false, memory_order_release);
+    printf("Stopped null playback\n");
+}
+
+static void null_resume(void *context) {
+    null_audio_context_t *ctx = context;
+    if (ctx->user_data) {
+        atomic_store_explicit(&ctx->playing, true, memory_order_release);
+        printf("Resumed null playback\n");
+    }
+}
+
+static void null_cleanup(void *context) {
+    null_audio_context_t *ctx = context;
+    free(ctx->buffer);
+    free(ctx);
+}
+
+static const audio_format_t* null_format(void *context) {
+    null_audio_context_t *ctx = context;
+    return &ctx->format;
+}
+
+static const char* null_strerror(int error_code) {
+    switch (error_code) {
+        case NULL_ERROR_NONE: return "Success";
+        case NULL_ERROR_ALLOC: return "Memory allocation failed";
+        case NULL_ERROR_FORMAT: return "Unsupported format";
+        default: return "Unknown error";
+    }
+}
+
+// Null driver vtable
+const audio_driver_t null_driver = {
+    .init = null_init,
+    .play = null_play,
+    .stop = null_stop,
+    .resume = null_resume,
+    .cleanup = null_cleanup,
+    .strerror = null_strerror,
+    .format = null_format
+};
@@ -0,0 +1,25 @@
+#ifndef NULL_DRIVER_H
+#define NULL_DRIVER_H
+
+#include <stdint.h>
+#include "audio_driver.h"
+
+// Timer-driven implementation of audio_driver_t that discards its output: pulls the
+// callback once per period at the real-time rate, like a sound card would. For load
+// testing on hosts without audio hardware; late wakeups are counted as underruns.
+extern const audio_driver_t null_driver;
+
+#define NULL_DEFAULT_PERIOD_FRAMES 256
+#define NULL_MAX_PERIOD_FRAMES 8192
+#define NULL_NATIVE_RATE 48000 // Rate used for AUDIO_RATE_NATIVE
+
+// Period used by the next init (call before init; 0 keeps the default)
+void null_driver_configure(uint32_t period_frames);
+
+// Setup signal handling for clean shutdown (call from main)
+void null_driver_setup_signals(void);
+
+// Run the period timer until the callback finishes the song, stop() is called or interrupted
+void null_driver_run(void *context);
+
+#endif // NULL_DRIVER_H
@@ -0,0 +1,351 @@
+#include "oscillator.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define OSC_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define OSC_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// ============================================================================
+// GLOBAL SINE TABLE
+// ============================================================================
+
+static int32_t sine_table[SINE_TABLE_SIZE];
+
+#define SINE_INDEX(phase) (((phase) >> 22) & (SINE_TABLE_SIZE - 1))
+
+// ============================================================================
+// BAND-LIMITED WAVETABLES
+// ============================================================================
+
+// Level l holds harmonics up to 2^(WAVETABLE_LEVELS - 1 - l) and serves increments below
+// 2^(32 - WAVETABLE_LEVELS + l), so its highest harmonic is always below Nyquist.
+// Each table has one guard sample (a copy of the first) for interpolation.
+static int32_t wavetables[NUM_WAVEFORMS - 1][WAVETABLE_LEVELS][WAVETABLE_SIZE + 1];
+
+#define WAVETABLE_FRAC_BITS 16
+
+// Fourier coefficient of harmonic h (sine series), 0 if the waveform lacks it
+static double waveform_harmonic(waveform_t waveform, int h) {
+    switch (waveform) {
+    case WAVEFORM_SAW:
+        return 2.0 / (M_PI * h);
+    case WAVEFORM_SQUARE:
+        return (h & 1) ? 4.0 / (M_PI * h) : 0.0;
+    case WAVEFORM_TRIANGLE:
+        return (h & 1) ? ((h & 2) ? -8.0 : 8.0) / (M_PI * M_PI * h * h) : 0.0;
+    default:
+        return 0.0;
+    }
+}
+
+// Sum the band-limited series for one level into level[], returns its peak magnitude
+static double sum_wavetable_level(const double* coeff, int max_harmonic, const double* sine, double* level) {
+    double peak = 0.0;
+
+    for (int i = 0; i < WAVETABLE_SIZE; i++) {
+        double sum = 0.0;
+        for (int h = 1; h <= max_harmonic; h++) {
+            if (coeff[h] != 0.0) {
+                sum += coeff[h] * sine[(int)(((long)h * i) & (WAVETABLE_SIZE - 1))];
+            }
+        }
+        level[i] = sum;
+        peak = fmax(peak, fabs(sum));
+    }
+
+    return peak;
+}
+
+static void build_wavetables(void) {
+    static double sine[WAVETABLE_SIZE]; // sin(2*pi*k/N), indexed by (h * i) mod N
+    static double level[WAVETABLE_SIZE];
+    static double coeff[WAVETABLE_SIZE / 2 + 1];
+
+    for (int i = 0; i < WAVETABLE_SIZE; i++) {
+        sine[i] = sin(2.0 * M_PI * i / WAVETABLE_SIZE);
+    }
+
+    for (int w = WAVEFORM_NONE + 1; w < NUM_WAVEFORMS; w++) {
+        for (int h = 1; h <= WAVETABLE_SIZE / 2; h++) {
+            coeff[h] = waveform_harmonic((waveform_t)w, h);
+        }
+
+        // One scale for all levels so loudness does not jump between octaves. Truncated series
+        // can peak above the full one (Gibbs), so find the largest peak first.
+        double peak = 0.0;
+        for (int l = 0; l < WAVETABLE_LEVELS; l++) {
+            peak = fmax(peak, sum_wavetable_level(coeff, 1 << (WAVETABLE_LEVELS - 1 - l), sine, level));
+        }
+        double scale = peak > 0.0 ? 0x7FFFFFFF / peak : 0.0;
+
+        for (int l = 0; l < WAVETABLE_LEVELS; l++) {
+            sum_wavetable_level(coeff, 1 << (WAVETABLE_LEVELS - 1 - l), sine, level);
+
+            int32_t* table = wavetables[w - 1][l];
+            for (int i = 0; i < WAVETABLE_SIZE; i++) {
+                table[i] = (int32_t)lrint(level[i] * scale);
+            }
+            table[WAVETABLE_SIZE] = table[0];
+        }
+    }
+}
+
+const int32_t* wavetable_for_increment(waveform_t waveform, uint32_t phase_increment) {
+    if (waveform <= WAVEFORM_NONE || waveform >= NUM_WAVEFORMS) {
+        return NULL;
+    }
+
+    int bit_length = phase_increment ? 32 - __builtin_clz(phase_increment) : 0;
+    int l = bit_length - (32 - WAVETABLE_LEVELS);
+    if (l < 0) {
+        l = 0;
+    } else if (l >= WAVETABLE_LEVELS) {
+        l = WAVETABLE_LEVELS - 1; // Fundamental at or above Nyquist: already aliasing
+    }
+    return wavetables[waveform - 1][l];
+}
+
+void render_wavetable(const int32_t* table, uint32_t* phase_accum, uint32_t phase_increment, int32_t amplitude,
+                      int32_t* out, size_t num_samples) {
+    uint32_t phase = *phase_accum;
+
+    for (size_t i = 0; i < num_samples; i++) {
+        uint32_t index = phase >> (32 - WAVETABLE_BITS);
+        int32_t frac = (int32_t)((phase << WAVETABLE_BITS) >> (32 - WAVETABLE_FRAC_BITS));
+        int32_t a = table[index];
+        int32_t b = table[index + 1];
+        int32_t sample = a + (int32_t)(((int64_t)(b - a) * frac) >> WAVETABLE_FRAC_BITS);
+
+        out[i] += (int32_t)(((int64_t)sample * amplitude) >> 31);
+        phase += phase_increment;
+    }
+
+    *phase_accum = phase;
+}
+
+// ============================================================================
+// SCALAR KERNEL (reference implementation)
+// ============================================================================
+
+static void render_partial_scalar(uint32_t* phase_accum, uint32_t increment, int32_t amplitude, int32_t* out,
+                                  size_t num_samples) {
+    uint32_t phase = *phase_accum;
+
+    for (size_t i = 0; i < num_samples; i++) {
+        // Apply partial amplitude (Q1.31 * Q1.31 = Q2.62, shift back to Q1.31)
+        out[i] += (int32_t)(((int64_t)sine_table[SINE_INDEX(phase)] * amplitude) >> 31);
+
+        // Advance phase (unsigned arithmetic wraps properly)
+        phase += increment;
+    }
+
+    *phase_accum = phase;
+}
+
+// ============================================================================
+// SSE2 KERNEL (4 samples per iteration)
+// ============================================================================
+
+#ifdef OSC_HAVE_X86
+
+// Per-lane signed (a * b) >> 31, truncated to 32 bits. SSE2 only has an unsigned
+// 32x32->64 multiply, so the high word is corrected for negative operands.
+static inline __m128i mulhi31_sse2(__m128i a, __m128i b, __m128i b_odd, __m128i b_sign_fix) {
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(a, b), 31);
+    __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b_odd), 31);
+    __m128i lo_mask = _mm_set_epi32(0, -1, 0, -1);
+    __m128i result = _mm_or_si128(_mm_and_si128(even, lo_mask), _mm_slli_epi64(odd, 32));
+
+    // Signed correction of the high word: subtract (a < 0 ? b : 0) + (b < 0 ? a : 0)
+    __m128i fix = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b), _mm_and_si128(b_sign_fix, a));
+    return _mm_sub_epi32(result, _mm_slli_epi32(fix, 1));
+}
+
+static void render_partial_sse2(uint32_t* phase_accum, uint32_t increment, int32_t amplitude, int32_t* out,
+                                size_t num_samples) {
+    const __m128i amplitudes = _mm_set1_epi32(amplitude);
+    const __m128i amplitude_sign = _mm_srai_epi32(amplitudes, 31);
+    const __m128i step = _mm_set1_epi32((int32_t)(increment * 4));
+    const __m128i index_mask = _mm_set1_epi32(SINE_TABLE_SIZE - 1);
+
+    uint32_t phase = *phase_accum;
+    __m128i phases = _mm_setr_epi32((int32_t)phase, (int32_t)(phase + increment), (int32_t)(phase + 2 * increment),
+                                    (int32_t)(phase + 3 * increment));
+
+    size_t i = 0;
+    for (; i + 4 <= num_samples; i += 4) {
+        uint32_t idx[4];
+        _mm_storeu_si128((__m128i*)idx, _mm_and_si128(_mm_srli_epi32(phases, 22), index_mask));
+        __m128i wave = _mm_setr_epi32(sine_table[idx[0]], sine_table[idx[1]], sine_table[idx[2]], sine_table[idx[3]]);
+
+        __m128i acc = _mm_loadu_si128((const __m128i*)&out[i]);
+        acc = _mm_add_epi32(acc, mulhi31_sse2(wave, amplitudes, amplitudes, amplitude_sign));
+        _mm_storeu_si128((__m128i*)&out[i], acc);
+
+        phases = _mm_add_epi32(phases, step);
+    }
+
+    *phase_accum = phase + (uint32_t)i * increment;
+    if (i < num_samples) {
+        render_partial_scalar(phase_accum, increment, amplitude, out + i, num_samples - i);
+    }
+}
+
+// ============================================================================
+// AVX2 KERNEL (8 samples per iteration, hardware gather)
+// ============================================================================
+
+__attribute__((target("avx2"))) static void render_partial_avx2(uint32_t* phase_accum, uint32_t increment,
+                                                                 int32_t amplitude, int32_t* out, size_t num_samples) {
+    const __m256i amplitudes = _mm256_set1_epi32(amplitude);
+    const __m256i step = _mm256_set1_epi32((int32_t)(increment * 8));
+    const __m256i index_mask = _mm256_set1_epi32(SINE_TABLE_SIZE - 1);
+    const __m256i lane_steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    uint32_t phase = *phase_accum;
+    __m256i phases = _mm256_add_epi32(_mm256_set1_epi32((int32_t)phase),
+                                      _mm256_mullo_epi32(lane_steps, _mm256_set1_epi32((int32_t)increment)));
+
+    size_t i = 0;
+    for (; i + 8 <= num_samples; i += 8) {
+        __m256i idx = _mm256_and_si256(_mm256_srli_epi32(phases, 22), index_mask);
+        __m256i wave = _mm256_i32gather_epi32(sine_table, idx, 4);
+
+        // Signed 32x32->64 on even and odd lanes, keep bits 31..62 of each product
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(wave, amplitudes), 31);
+        __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(wave, 32), amplitudes);
+        __m256i product = _mm256_blend_epi32(even, _mm256_slli_epi64(_mm256_srli_epi64(odd, 31), 32), 0xAA);
+
+        __m256i acc = _mm256_loadu_si256((const __m256i*)&out[i]);
+        _mm256_storeu_si256((__m256i*)&out[i], _mm256_add_epi32(acc, product));
+
+        phases = _mm256_add_epi32(phases, step);
+    }
+
+    *phase_accum = phase + (uint32_t)i * increment;
+    if (i < num_samples) {
+        render_partial_scalar(phase_accum, increment, amplitude, out + i, num_samples - i);
+    }
+}
+
+#endif // OSC_HAVE_X86
+
+// ============================================================================
+// NEON KERNEL (4 samples per iteration)
+// ============================================================================
+
+#ifdef OSC_HAVE_NEON
+
+static void render_partial_neon(uint32_t* phase_accum, uint32_t increment, int32_t amplitude, int32_t* out,
+                                size_t num_samples) {
+    const int32x4_t amplitudes = vdupq_n_s32(amplitude);
+    const uint32x4_t step = vdupq_n_u32(increment * 4);
+
+    uint32_t phase = *phase_accum;
+    const uint32_t lanes[4] = {phase, phase + increment, phase + 2 * increment, phase + 3 * increment};
+    uint32x4_t phases = vld1q_u32(lanes);
+
+    size_t i = 0;
+    for (; i + 4 <= num_samples; i += 4) {
+        uint32_t idx[4];
+        vst1q_u32(idx, vshrq_n_u32(phases, 22)); // 10-bit index, no mask needed
+        const int32_t gathered[4] = {sine_table[idx[0]], sine_table[idx[1]], sine_table[idx[2]], sine_table[idx[3]]};
+
+        // vqdmulh computes (2 * a * b) >> 32 == (a * b) >> 31; it only saturates for
+        // INT32_MIN * INT32_MIN, which the sine table never contains
+        int32x4_t product = vqdmulhq_s32(vld1q_s32(gathered), amplitudes);
+        vst1q_s32(&out[i], vaddq_s32(vld1q_s32(&out[i]), product));
+
+        phases = vaddq_u32(phases, step);
+    }
+
+    *phase_accum = phase + (uint32_t)i * increment;
+    if (i < num_samples) {
+        render_partial_scalar(phase_accum, increment, amplitude, out + i, num_samples - i);
+    }
+}
+
+#endif // OSC_HAVE_NEON
+
+// ============================================================================
+// KERNEL DISPATCH
+// ============================================================================
+
+typedef void (*partial_kernel_fn)(uint32_t* phase_accum, uint32_t increment, int32_t amplitude, int32_t* out,
+                                  size_t num_samples);
+
+static partial_kernel_fn render_partial = render_partial_scalar;
+static const char* kernel_name = "scalar";
+
+bool oscillator_use_kernel(oscillator_kernel_t kernel) {
+    switch (kernel) {
+    case OSC_KERNEL_AUTO:
+#if defined(OSC_HAVE_X86)
+        if (oscillator_use_kernel(OSC_KERNEL_AVX2)) {
+            return true;
+        }
+        return oscillator_use_kernel(OSC_KERNEL_SSE2);
+#elif defined(OSC_HAVE_NEON)
+        return oscillator_use_kernel(OSC_KERNEL_NEON);
+#else
+        return oscillator_use_kernel(OSC_KERNEL_SCALAR);
+#endif
+    case OSC_KERNEL_SCALAR:
+        render_partial = render_partial_scalar;
+        kernel_name = "scalar";
+        return true;
+#ifdef OSC_HAVE_X86
+    case OSC_KERNEL_SSE2:
+        if (!__builtin_cpu_supports("sse2")) {
+            return false;
+        }
+        render_partial = render_partial_sse2;
+        kernel_name = "sse2";
+        return true;
+    case OSC_KERNEL_AVX2:
+        if (!__builtin_cpu_supports("avx2")) {
+            return false;
+        }
+        render_partial = render_partial_avx2;
+        kernel_name = "avx2";
+        return true;
+#endif
+#ifdef OSC_HAVE_NEON
+    case OSC_KERNEL_NEON:
+        render_partial = render_partial_neon;
+        kernel_name = "neon";
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* oscillator_kernel_name(void) { return kernel_name; }
+
+void oscillator_init(void) {
+    for (int i = 0; i < SINE_TABLE_SIZE; i++) {
+        double angle = 2.0 * M_PI * i / SINE_TABLE_SIZE;
+        sine_table[i] = (int32_t)(sin(angle) * 0x7FFFFFFF);
+    }
+    build_wavetables();
+
+#ifdef OSC_HAVE_X86
+    __builtin_cpu_init();
+#endif
+    oscillator_use_kernel(OSC_KERNEL_AUTO);
+}
+
+void render_partials(uint32_t* phase_accum, const uint32_t* phase_increment, const int32_t* amplitude, int num_partials,
+                     int32_t* out, size_t num_samples) {
+    for (int p = 0; p < num_partials; p++) {
+        render_partial(&phase_accum[p], phase_increment[p], amplitude[p], out, num_samples);
+    }
+}
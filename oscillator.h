@@ -0,0 +1,66 @@
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// DDS OSCILLATOR TYPES
+// ============================================================================
+
+#define SINE_TABLE_SIZE 1024
+
+#ifndef WAVETABLE_BITS
+#define WAVETABLE_BITS 11 // 2048-sample single-cycle tables (lower for small targets)
+#endif
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+#define WAVETABLE_LEVELS WAVETABLE_BITS // One band-limited table per octave of fundamental
+
+// Band-limited wavetable shapes (WAVEFORM_NONE = additive sine partials)
+typedef enum {
+    WAVEFORM_NONE,
+    WAVEFORM_SAW,
+    WAVEFORM_SQUARE,
+    WAVEFORM_TRIANGLE,
+    NUM_WAVEFORMS,
+} waveform_t;
+
+// Partial bank kernel implementations (selected at runtime on x86, compile time on ARM)
+typedef enum {
+    OSC_KERNEL_AUTO, // Best kernel supported by this CPU
+    OSC_KERNEL_SCALAR,
+    OSC_KERNEL_SSE2,
+    OSC_KERNEL_AVX2,
+    OSC_KERNEL_NEON,
+} oscillator_kernel_t;
+
+// ============================================================================
+// OSCILLATOR FUNCTIONS
+// ============================================================================
+
+// Build the sine table and wavetables and select the partial bank kernel (call once at startup)
+void oscillator_init(void);
+
+// Force a specific kernel, returns false if it is not supported on this build/CPU
+bool oscillator_use_kernel(oscillator_kernel_t kernel);
+
+// Name of the kernel currently in use
+const char* oscillator_kernel_name(void);
+
+// Add num_partials sine partials into out[0..num_samples) and advance their phase accumulators.
+// Partials are passed as parallel arrays (phase accumulators are unsigned for proper DDS wraparound).
+// Every kernel produces bit-identical results: out[i] += (sine[phase >> 22] * amplitude) >> 31
+void render_partials(uint32_t* phase_accum, const uint32_t* phase_increment, const int32_t* amplitude, int num_partials,
+                     int32_t* out, size_t num_samples);
+
+// Band-limited table for a waveform whose fundamental advances phase_increment per sample:
+// every harmonic it contains stays below Nyquist. NULL for WAVEFORM_NONE.
+const int32_t* wavetable_for_increment(waveform_t waveform, uint32_t phase_increment);
+
+// Add a linearly interpolated wavetable oscillator into out[0..num_samples) and advance its phase:
+// out[i] += (lerp(table, phase) * amplitude) >> 31
+void render_wavetable(const int32_t* table, uint32_t* phase_accum, uint32_t phase_increment, int32_t amplitude,
+                      int32_t* out, size_t num_samples);
+
+#endif // OSCILLATOR_H
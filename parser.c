@@ -1,6 +1,5 @@
 #include "parser.h"
 
-#include <ctype.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -119,23 +118,37 @@ bool is_dotted(const note_t* note) { return note && note->dotted; }
 
 bool is_tuplet(const note_t* note) { return note && note->tuplet > 0; }
 
-float get_tuplet_ratio(int tuplet) {
+void get_tuplet_fraction(int tuplet, int* numerator, int* denominator) {
     switch (tuplet) {
-    case 0:
-        return 1.0f; // normal notes
-    case 3:
-        return 2.0f / 3.0f; // triplet (3 in time of 2)
-    case 5:
-        return 4.0f / 5.0f; // quintuplet (5 in time of 4)
-    case 6:
-        return 4.0f / 6.0f; // sextuplet (6 in time of 4)
-    case 7:
-        return 4.0f / 7.0f; // septuplet (7 in time of 4)
-    default:
-        return 1.0f;
+    case 3: // triplet (3 in time of 2)
+        *numerator = 2;
+        *denominator = 3;
+        return;
+    case 5: // quintuplet (5 in time of 4)
+        *numerator = 4;
+        *denominator = 5;
+        return;
+    case 6: // sextuplet (6 in time of 4)
+        *numerator = 4;
+        *denominator = 6;
+        return;
+    case 7: // septuplet (7 in time of 4)
+        *numerator = 4;
+        *denominator = 7;
+        return;
+    default: // normal notes
+        *numerator = 1;
+        *denominator = 1;
+        return;
     }
 }
 
+float get_tuplet_ratio(int tuplet) {
+    int numerator, denominator;
+    get_tuplet_fraction(tuplet, &numerator, &denominator);
+    return (float)numerator / (float)denominator;
+}
+
 int note_name_to_semitone(char note_name) {
     switch (note_name) {
     case 'c':
@@ -240,317 +253,500 @@ int calculate_key_transposition(const key_signature_t* from_key, const key_signa
 }
 
 // ============================================================================
-// PARSING FUNCTIONS
+// LEXER
 // ============================================================================
 
-#define MAX_CHORD_SIZE 8
+// Character classes for the hot loops: one table load instead of locale-aware isspace/isdigit
+// calls and comparison chains. A character can be in several classes ('s' and 'f' are both
+// accidentals and, like 'n', letters of tuplet markers).
+enum {
+    CC_SPACE = 1 << 0,
+    CC_DIGIT = 1 << 1,
+    CC_PITCH = 1 << 2, // a-g
+    CC_ACCIDENTAL = 1 << 3, // s, f
+    CC_OCTAVE = 1 << 4, // ' ,
+};
+
+static const uint8_t char_class[256] = {
+    [' '] = CC_SPACE,  ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE,
+    ['\r'] = CC_SPACE, ['0'] = CC_DIGIT,  ['1'] = CC_DIGIT,  ['2'] = CC_DIGIT,  ['3'] = CC_DIGIT,
+    ['4'] = CC_DIGIT,  ['5'] = CC_DIGIT,  ['6'] = CC_DIGIT,  ['7'] = CC_DIGIT,  ['8'] = CC_DIGIT,
+    ['9'] = CC_DIGIT,  ['a'] = CC_PITCH,  ['b'] = CC_PITCH,  ['c'] = CC_PITCH,  ['d'] = CC_PITCH,
+    ['e'] = CC_PITCH,  ['f'] = CC_PITCH | CC_ACCIDENTAL, ['g'] = CC_PITCH, ['s'] = CC_ACCIDENTAL,
+    ['\''] = CC_OCTAVE, [','] = CC_OCTAVE,
+};
+
+// Per-character deltas and markers, 0 for every other character
+static const int8_t accidental_delta[256] = {['s'] = 1, ['f'] = -1};
+static const int8_t octave_delta[256] = {['\''] = 1, [','] = -1};
+static const int8_t tuplet_marker[256] = {['t'] = 3, ['q'] = 5, ['x'] = 6, ['s'] = 7, ['n'] = 9};
+
+#define MAX_NOTE_VALUE 128
+
+static inline bool has_class(char c, uint8_t cls) { return (char_class[(unsigned char)c] & cls) != 0; }
+
+// Whitespace skipping. Generated scores are mostly single spaces, which the scalar check handles;
+// longer runs (indentation, blank lines) are scanned 16 bytes at a time with SSE2. A load never
+// crosses into the next 4 KiB page, so it cannot fault past the terminator, but it still reads up to
+// 15 bytes beyond the string. AddressSanitizer reports that, so sanitized builds use the scalar loop.
+#if defined(__SANITIZE_ADDRESS__) // GCC
+#define PARSER_ASAN 1
+#elif defined(__has_feature) // Clang
+#if __has_feature(address_sanitizer)
+#define PARSER_ASAN 1
+#endif
+#endif
+
+#ifndef MUSICBOX_PARSER_SIMD
+#ifdef PARSER_ASAN
+#define MUSICBOX_PARSER_SIMD 0
+#else
+#define MUSICBOX_PARSER_SIMD 1
+#endif
+#endif
+
+#if MUSICBOX_PARSER_SIMD && defined(__SSE2__)
+#include <emmintrin.h>
+
+#define PAGE_SIZE_MIN 4096
+
+// Bit i set if byte i is whitespace
+static inline unsigned space_mask(__m128i bytes) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t'); // \t \n \v \f \r are the contiguous range 9..13
+    const __m128i control_span = _mm_set1_epi8('\r' - '\t');
+    __m128i is_space = _mm_cmpeq_epi8(bytes, space);
+    // Unsigned (c - '\t') <= 4, as max(x, span) == span
+    __m128i offset = _mm_sub_epi8(bytes, tab);
+    __m128i is_control = _mm_cmpeq_epi8(_mm_max_epu8(offset, control_span), control_span);
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(is_space, is_control));
+}
 
-note_t parse_note_without_duration(const char** input_pos) {
-    note_t note = {0}; // Initialize all fields to 0
-    const char* p = *input_pos;
+static const char* skip_space_run(const char* p) {
+    // Most runs (an indent, a line break) end within one unaligned load
+    if (((uintptr_t)p & (PAGE_SIZE_MIN - 1)) <= PAGE_SIZE_MIN - 16) {
+        unsigned mask = space_mask(_mm_loadu_si128((const __m128i*)(const void*)p));
+        if (mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask); // First non-space byte (the terminator included)
+        }
+        p += 16;
+    }
 
-    // Skip whitespace
-    while (*p && isspace(*p)) {
+    // Longer runs: finish the unaligned head, then aligned loads which never cross a page
+    while (((uintptr_t)p & 15) != 0) {
+        if (!has_class(*p, CC_SPACE)) {
+            return p;
+        }
+        p++;
+    }
+    for (;;) {
+        unsigned mask = space_mask(_mm_load_si128((const __m128i*)(const void*)p));
+        if (mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+}
+#else
+static const char* skip_space_run(const char* p) {
+    while (has_class(*p, CC_SPACE)) {
         p++;
     }
+    return p;
+}
+#endif
 
-    if (!*p) {
-        *input_pos = p;
-        return note;
+static inline const char* skip_space(const char* p) {
+    if (!has_class(*p, CC_SPACE)) {
+        return p;
     }
+    if (!has_class(p[1], CC_SPACE)) {
+        return p + 1; // The common single separator
+    }
+    return skip_space_run(p + 2);
+}
 
-    // Check for rest
+// Note name, accidentals and octave marks shared by single and chord notes ("r" takes neither).
+// Returns the position after them, or NULL (p untouched) if p does not start a note.
+static const char* scan_note_body(const char* p, note_t* note) {
     if (*p == 'r') {
-        note.note_name = 'r';
-        p++;
-        *input_pos = p;
-        return note;
+        note->note_name = 'r';
+        return p + 1;
     }
-
-    // Parse note name (a-g)
-    if (!is_valid_note_name(*p)) {
-        *input_pos = p;
-        return note;
+    if (!has_class(*p, CC_PITCH)) {
+        return NULL;
     }
 
-    note.note_name = *p;
-    p++;
+    note->note_name = *p++;
+    while (has_class(*p, CC_ACCIDENTAL)) {
+        note->accidental += accidental_delta[(unsigned char)*p++];
+    }
+    while (has_class(*p, CC_OCTAVE)) {
+        note->octave_shift += octave_delta[(unsigned char)*p++];
+    }
+    return p;
+}
 
-    // Parse accidentals (s for sharp, f for flat)
-    while (*p == 's' || *p == 'f') {
-        if (*p == 's') {
-            note.accidental++;
-        } else if (*p == 'f') {
-            note.accidental--;
-        }
-        p++;
+// Optional note value: 0 if absent, -1 if present but not a power of two up to MAX_NOTE_VALUE
+static const char* scan_value(const char* p, int* value) {
+    if (!has_class(*p, CC_DIGIT)) {
+        *value = 0;
+        return p;
     }
 
-    // Parse octave shifts (' for up, , for down)
-    while (*p == '\'' || *p == ',') {
-        if (*p == '\'') {
-            note.octave_shift++;
-        } else if (*p == ',') {
-            note.octave_shift--;
+    int v = 0;
+    while (has_class(*p, CC_DIGIT)) {
+        if (v <= MAX_NOTE_VALUE) {
+            v = v * 10 + (*p - '0'); // Saturates just past the limit instead of overflowing
         }
         p++;
     }
+    *value = (v >= 1 && v <= MAX_NOTE_VALUE && (v & (v - 1)) == 0) ? v : -1;
+    return p;
+}
 
-    *input_pos = p;
-    return note;
+// Optional dot and tuplet marker
+static const char* scan_modifiers(const char* p, bool* dotted, int8_t* tuplet) {
+    *dotted = (*p == '.');
+    p += *dotted;
+    *tuplet = tuplet_marker[(unsigned char)*p];
+    return p + (*tuplet != 0);
 }
 
-void parse_duration_and_modifiers(const char** input_pos, int* last_duration, note_t* notes, int note_count) {
-    const char* p = *input_pos;
-
-    // Parse duration
-    int duration = *last_duration; // default
-    if (isdigit(*p)) {
-        duration = 0;
-        while (isdigit(*p)) {
-            duration = duration * 10 + (*p - '0');
-            p++;
-        }
+// ============================================================================
+// PARSING FUNCTIONS
+// ============================================================================
 
-        // Validate duration (power of 2)
-        if (duration == 1 || duration == 2 || duration == 4 || duration == 8 || duration == 16 || duration == 32 ||
-            duration == 64 || duration == 128) {
-            *last_duration = duration;
-        } else {
-            duration = *last_duration; // Invalid duration, keep previous
-        }
-    }
+// Why a scan failed, where, and where recovery resumes
+typedef struct {
+    parse_error_kind_t kind;
+    const char* at;
+    const char* resume;
+} scan_error_t;
+
+static const char* scan_fail(scan_error_t* error, parse_error_kind_t kind, const char* at, const char* resume) {
+    error->kind = kind;
+    error->at = at;
+    error->resume = resume;
+    return NULL;
+}
 
-    // Parse dots
-    bool dotted = false;
-    if (*p == '.') {
-        dotted = true;
+// Recovery after a bad note: resume at the next whitespace, chord, [instrument] or {track}
+static const char* skip_token(const char* p) {
+    if (*p) {
         p++;
     }
-
-    // Parse tuplets
-    int tuplet = 0;
-    if (*p == 't') {
-        tuplet = 3;
-        p++;
-    } else if (*p == 'q') {
-        tuplet = 5;
-        p++;
-    } else if (*p == 'x') {
-        tuplet = 6;
+    while (*p && !has_class(*p, CC_SPACE) && *p != '<' && *p != '[' && *p != '{') {
         p++;
-    } else if (*p == 's') {
-        tuplet = 7;
-        p++;
-    } else if (*p == 'n') {
-        tuplet = 9;
+    }
+    return p;
+}
+
+// Recovery inside a chord: resume after its closing '>' and duration
+static const char* skip_chord(const char* p) {
+    while (*p && *p != '>') {
         p++;
     }
+    return skip_token(p);
+}
 
-    // Apply to all notes
-    for (int i = 0; i < note_count; i++) {
-        notes[i].value = duration;
-        notes[i].dotted = dotted;
-        notes[i].tuplet = tuplet;
+// Single note with its duration and modifiers, NULL on error
+static const char* scan_note(const char* p, int* last_duration, note_t* note, scan_error_t* error) {
+    const char* end = scan_note_body(p, note);
+    if (!end) {
+        return scan_fail(error, PARSE_ERROR_UNEXPECTED_CHARACTER, p, skip_token(p));
     }
 
-    *input_pos = p;
+    int value;
+    p = scan_value(end, &value);
+    if (value < 0) {
+        return scan_fail(error, PARSE_ERROR_INVALID_DURATION, end, skip_token(end));
+    }
+    if (value > 0) {
+        *last_duration = value; // Update last duration for next note
+    }
+    note->value = (uint8_t)*last_duration;
+
+    return scan_modifiers(p, &note->dotted, &note->tuplet);
 }
 
-note_t* parse_chord(const char** input_pos, int* chord_size, int* last_duration) {
-    const char* p = *input_pos;
-    *chord_size = 0;
+// Chord from its '<' through the duration and modifiers shared by its notes, NULL on error.
+// "<>" is an empty chord and yields no notes.
+static const char* scan_chord(const char* p, int* last_duration, note_t* notes, int* count, scan_error_t* error) {
+    const char* open = p++;
+    int n = 0;
 
-    // Skip whitespace
-    while (*p && isspace(*p)) {
-        p++;
-    }
+    for (p = skip_space(p); *p != '>'; p = skip_space(p)) {
+        if (!*p) {
+            return scan_fail(error, PARSE_ERROR_UNTERMINATED_CHORD, open, p);
+        }
+        if (n == MAX_CHORD_SIZE) {
+            return scan_fail(error, PARSE_ERROR_CHORD_TOO_LARGE, p, skip_chord(p));
+        }
 
-    // Expect '<'
-    if (*p != '<') {
-        return NULL;
+        note_t note = {0};
+        const char* end = scan_note_body(p, &note);
+        if (!end) {
+            return scan_fail(error, PARSE_ERROR_UNEXPECTED_CHARACTER, p, skip_chord(p));
+        }
+        notes[n++] = note;
+        p = end;
     }
     p++;
 
-    note_t* chord_notes = malloc(MAX_CHORD_SIZE * sizeof(note_t));
-    if (!chord_notes) {
-        return NULL;
+    int value;
+    const char* end = scan_value(p, &value);
+    if (value < 0) {
+        return scan_fail(error, PARSE_ERROR_INVALID_DURATION, p, skip_token(p));
+    }
+    if (value > 0) {
+        *last_duration = value;
     }
 
-    // Parse notes until '>'
-    while (*p && *p != '>') {
-        if (*chord_size >= MAX_CHORD_SIZE) {
-            break; // Chord too large
-        }
+    bool dotted;
+    int8_t tuplet;
+    end = scan_modifiers(end, &dotted, &tuplet);
 
-        note_t note = parse_note_without_duration(&p);
-        if (note.note_name == 0) {
-            break; // Failed to parse note
-        }
+    // Apply to all notes
+    for (int i = 0; i < n; i++) {
+        notes[i].value = (uint8_t)*last_duration;
+        notes[i].dotted = dotted;
+        notes[i].tuplet = tuplet;
+    }
 
-        chord_notes[*chord_size] = note;
-        (*chord_size)++;
+    *count = n;
+    return end;
+}
 
-        // Skip whitespace
-        while (*p && isspace(*p)) {
-            p++;
-        }
+// [name] instrument change, on one line. An unknown name selects the default instrument.
+static const char* scan_instrument(const char* p, const instrument_t** instrument, scan_error_t* error) {
+    const char* name = p + 1;
+    const char* close = name;
+    while (*close && *close != ']' && *close != '\n') {
+        close++;
     }
-
-    // Expect '>'
-    if (*p == '>') {
-        p++;
+    if (*close != ']') {
+        return scan_fail(error, PARSE_ERROR_UNTERMINATED_INSTRUMENT, p, close);
     }
 
-    // Parse duration/modifiers that apply to whole chord
-    if (*chord_size > 0) {
-        parse_duration_and_modifiers(&p, last_duration, chord_notes, *chord_size);
+    const instrument_t* found = NULL;
+    size_t len = (size_t)(close - name);
+    if (len <= MAX_INSTRUMENT_NAME) {
+        char instrument_name[MAX_INSTRUMENT_NAME + 1];
+        memcpy(instrument_name, name, len);
+        instrument_name[len] = '\0';
+        found = find_instrument(instrument_name);
     }
 
-    *input_pos = p;
-    return chord_notes;
+    *instrument = found ? found : lookup_instrument(NULL);
+    if (!found) {
+        return scan_fail(error, PARSE_ERROR_UNKNOWN_INSTRUMENT, name, close + 1);
+    }
+    return close + 1;
 }
 
-note_t parse_note(const char** input_pos, int* last_duration) {
-    note_t note = {0}; // Initialize all fields to zeros
+// {name} track switch. A new name starts a track with the default instrument and duration;
+// a known one resumes where that track left off. "{}" is the unnamed default track.
+static const char* scan_track(parse_cursor_t* cursor, const char* p, scan_error_t* error) {
+    const char* name = p + 1;
+    const char* close = name;
+    while (*close && *close != '}' && *close != '\n') {
+        close++;
+    }
+    if (*close != '}') {
+        return scan_fail(error, PARSE_ERROR_UNTERMINATED_TRACK, p, close);
+    }
 
-    if (!input_pos || !*input_pos || !last_duration) {
-        return note; // Return empty note on error
+    size_t len = (size_t)(close - name);
+    int track = 0;
+    if (len > 0) {
+        for (track = 1; track < cursor->num_tracks; track++) {
+            if (cursor->track_name_lengths[track] == len && memcmp(cursor->track_names[track], name, len) == 0) {
+                break;
+            }
+        }
+        if (track == cursor->num_tracks) {
+            if (track == MAX_SCORE_TRACKS) {
+                return scan_fail(error, PARSE_ERROR_TOO_MANY_TRACKS, name, close + 1);
+            }
+            cursor->track_names[track] = name;
+            cursor->track_name_lengths[track] = len;
+            cursor->track_instrument[track] = &pluck_sine_instrument;
+            cursor->track_last_duration[track] = 4;
+            cursor->num_tracks++;
+        }
     }
 
-    // Set default duration
-    note.value = *last_duration;
+    // Park the current track's selections and pick up the new one's
+    cursor->track_instrument[cursor->track] = cursor->instrument;
+    cursor->track_last_duration[cursor->track] = cursor->last_duration;
+    cursor->track = track;
+    cursor->instrument = cursor->track_instrument[track];
+    cursor->last_duration = cursor->track_last_duration[track];
+    return close + 1;
+}
 
-    const char* p = *input_pos;
+note_t parse_note_without_duration(const char** input_pos) {
+    note_t note = {0}; // Initialize all fields to 0
+    const char* p = skip_space(*input_pos);
 
-    // Skip whitespace
-    while (*p && isspace(*p)) {
-        p++;
-    }
+    const char* end = scan_note_body(p, &note);
+    *input_pos = end ? end : p;
+    return note;
+}
 
-    if (!*p) {
-        *input_pos = p;
-        return note; // End of string - return empty note
+void parse_duration_and_modifiers(const char** input_pos, int* last_duration, note_t* notes, int note_count) {
+    int value;
+    const char* p = scan_value(*input_pos, &value);
+    if (value > 0) {
+        *last_duration = value;
     }
+    int duration = *last_duration; // Absent or invalid: keep the previous one
 
-    // Check for rest
-    if (*p == 'r') {
-        note.note_name = 'r';
-        p++;
-        goto parse_duration;
-    }
+    bool dotted;
+    int8_t tuplet;
+    p = scan_modifiers(p, &dotted, &tuplet);
 
-    // Parse note name (a-g)
-    if (!is_valid_note_name(*p)) {
-        return note; // Invalid note name - return empty note
+    // Apply to all notes
+    for (int i = 0; i < note_count; i++) {
+        notes[i].value = (uint8_t)duration;
+        notes[i].dotted = dotted;
+        notes[i].tuplet = tuplet;
     }
 
-    note.note_name = *p;
-    p++;
+    *input_pos = p;
+}
 
-    // Parse accidentals (s for sharp, f for flat)
-    while (*p == 's' || *p == 'f') {
-        if (*p == 's') {
-            note.accidental++;
-        } else if (*p == 'f') {
-            note.accidental--;
-        }
-        p++;
+// Parse a chord into caller storage of MAX_CHORD_SIZE notes, returns false if there is no '<'.
+// A malformed chord yields no notes and is skipped.
+bool parse_chord(const char** input_pos, note_t* chord_notes, int* chord_size, int* last_duration) {
+    const char* p = skip_space(*input_pos);
+    *chord_size = 0;
+
+    // Expect '<'
+    if (*p != '<') {
+        return false;
     }
 
-    // Parse octave shifts (' for up, , for down)
-    while (*p == '\'' || *p == ',') {
-        if (*p == '\'') {
-            note.octave_shift++;
-        } else if (*p == ',') {
-            note.octave_shift--;
-        }
-        p++;
+    scan_error_t error;
+    const char* end = scan_chord(p, last_duration, chord_notes, chord_size, &error);
+    if (!end) {
+        *chord_size = 0;
+        end = error.resume;
     }
 
-parse_duration:
-    // Parse duration (if present)
-    if (isdigit(*p)) {
-        int duration = 0;
-        while (isdigit(*p)) {
-            duration = duration * 10 + (*p - '0');
-            p++;
-        }
+    *input_pos = end;
+    return true;
+}
 
-        // Validate duration (power of 2)
-        if (duration == 1 || duration == 2 || duration == 4 || duration == 8 || duration == 16 || duration == 32 ||
-            duration == 64 || duration == 128) {
-            note.value = duration;
-            *last_duration = duration; // Update last duration for next note
-        } else {
-            // Invalid duration - return empty note
-            note_t empty = {0};
-            return empty;
-        }
+note_t parse_note(const char** input_pos, int* last_duration) {
+    note_t note = {0}; // Initialize all fields to zeros
+
+    if (!input_pos || !*input_pos || !last_duration) {
+        return note; // Return empty note on error
     }
 
-    // Parse dots for dotted notes
-    if (*p == '.') {
-        p++;
-        note.dotted = true;
+    const char* p = skip_space(*input_pos);
+    if (!*p) {
+        *input_pos = p;
+        return note; // End of string - return empty note
     }
 
-    // Parse tuplet markers
-    if (*p == 't') {
-        p++;
-        note.tuplet = 3; // triplet
-    } else if (*p == 'q') {
-        p++;
-        note.tuplet = 5; // quintuplet
-    } else if (*p == 'x') {
-        p++;
-        note.tuplet = 6; // sextuplet
-    } else if (*p == 's') {
-        p++;
-        note.tuplet = 7; // septuplet
-    } else if (*p == 'n') {
-        p++;
-        note.tuplet = 9; // nonuplet
+    scan_error_t error;
+    note_t parsed = {0};
+    const char* end = scan_note(p, last_duration, &parsed, &error);
+    if (!end) {
+        return note; // Invalid note name or value - return empty note
     }
 
-    *input_pos = p; // Update input position
-    return note;
+    *input_pos = end; // Update input position
+    return parsed;
 }
 
-note_array_t parse_music(const char* input) {
-    note_array_t array = {0}; // Clean initialization
-    const instrument_t* current_instrument = &pluck_sine_instrument;
+// ============================================================================
+// STREAMING PARSER
+// ============================================================================
 
-    if (!input) {
-        return array;
-    }
+void parse_cursor_init(parse_cursor_t* cursor, const char* input) {
+    cursor->pos = input;
+    cursor->instrument = &pluck_sine_instrument;
+    cursor->last_duration = 4;
+    cursor->chord_counter = 1;
+    cursor->track = 0;
+    cursor->num_tracks = 1;
+    cursor->track_names[0] = NULL;
+    cursor->track_name_lengths[0] = 0;
+    cursor->done = (input == NULL);
+    cursor->recover = false;
+    cursor->error_count = 0;
+    cursor->error = (parse_diagnostic_t){.kind = PARSE_OK};
+    cursor->diagnostics = NULL;
+    cursor->max_diagnostics = 0;
+    cursor->input = input;
+    cursor->line_start = input;
+    cursor->line_scanned = input;
+    cursor->line = 1;
+}
 
-    const char* p = input;
-    int last_duration = 4;
-    int chord_counter = 1;
+// Record an error with its line and column. Errors come in input order, so line counting
+// resumes where the previous one stopped and stays linear in the input.
+static void report_error(parse_cursor_t* cursor, const scan_error_t* error) {
+    const char* p = cursor->line_scanned;
+    const char* newline;
+    while ((newline = memchr(p, '\n', (size_t)(error->at - p))) != NULL) {
+        cursor->line++;
+        cursor->line_start = p = newline + 1;
+    }
+    cursor->line_scanned = error->at;
+
+    cursor->error = (parse_diagnostic_t){
+        .kind = error->kind,
+        .line = cursor->line,
+        .column = (int)(error->at - cursor->line_start) + 1,
+        .offset = (size_t)(error->at - cursor->input),
+    };
+    if (cursor->error_count < cursor->max_diagnostics) {
+        cursor->diagnostics[cursor->error_count] = cursor->error;
+    }
+    cursor->error_count++;
+}
 
-    while (*p) {
-        // Skip whitespace
-        while (*p && isspace(*p)) {
-            p++;
-        }
+// Next note or chord: the number of notes written, 0 at the end of the input, or -1 after an
+// error (in cursor->error, with cursor->pos moved to where recovery resumes)
+static int cursor_scan(parse_cursor_t* cursor, note_t* notes) {
+    const char* p = cursor->pos;
+    scan_error_t error;
 
-        if (!*p)
-            break;
+    for (;;) {
+        p = skip_space(p);
+
+        if (!*p) {
+            cursor->pos = p;
+            return 0;
+        }
 
         // Check for instrument change [name]
         if (*p == '[') {
-            p++;
-            char instrument_name[32] = {0};
-            int name_idx = 0;
-            while (*p && *p != ']' && name_idx < 31) {
-                instrument_name[name_idx++] = *p++;
+            p = scan_instrument(p, &cursor->instrument, &error);
+            if (!p && error.kind == PARSE_ERROR_UNKNOWN_INSTRUMENT) {
+                report_error(cursor, &error); // A warning: the default instrument plays instead
+                p = error.resume;
+            }
+            if (!p) {
+                break;
             }
+            continue;
+        }
 
-            if (*p == ']') {
-                p++;
-                instrument_name[name_idx] = '\0';
-                current_instrument = lookup_instrument(instrument_name);
+        // Check for track switch {name}
+        if (*p == '{') {
+            p = scan_track(cursor, p, &error);
+            if (!p && error.kind == PARSE_ERROR_TOO_MANY_TRACKS) {
+                report_error(cursor, &error); // A warning: the notes stay on the current track
+                p = error.resume;
+            }
+            if (!p) {
+                break;
             }
             continue;
         }
@@ -558,45 +754,143 @@ note_array_t parse_music(const char* input) {
         // Check for chord syntax
         if (*p == '<') {
             int chord_size;
-            note_t* chord_notes = parse_chord(&p, &chord_size, &last_duration);
+            p = scan_chord(p, &cursor->last_duration, notes, &chord_size, &error);
+            if (!p) {
+                break;
+            }
+
+            if (chord_size > 0) {
+                int current_chord_id = cursor->chord_counter;
 
-            if (chord_notes && chord_size > 0) {
-                int current_chord_id = chord_counter++;
+                // Chords are identified by their consecutive run, so ids only need to differ from
+                // their neighbours: wrap within 1..INT16_MAX instead of overflowing into "no chord"
+                cursor->chord_counter = cursor->chord_counter % INT16_MAX + 1;
 
                 for (int i = 0; i < chord_size; i++) {
-                    chord_notes[i].chord_id = (int16_t)current_chord_id;
-                    chord_notes[i].instrument = current_instrument;
-                    note_array_push(&array, chord_notes[i]);
+                    notes[i].chord_id = (int16_t)current_chord_id;
+                    notes[i].instrument = cursor->instrument;
+                    notes[i].track = (uint8_t)cursor->track;
                 }
-                free(chord_notes);
+                cursor->pos = p;
+                return chord_size;
             }
-        } else {
-            // Parse single note
-            note_t note = parse_note(&p, &last_duration);
+            continue; // Empty chord
+        }
+
+        // Parse single note
+        note_t note = {0};
+        p = scan_note(p, &cursor->last_duration, &note, &error);
+        if (!p) {
+            break;
+        }
 
-            if (note.note_name == 0) {
+        note.instrument = cursor->instrument;
+        note.track = (uint8_t)cursor->track;
+        notes[0] = note;
+        cursor->pos = p;
+        return 1;
+    }
+
+    report_error(cursor, &error);
+    cursor->pos = error.resume;
+    return -1;
+}
+
+int parse_cursor_next(parse_cursor_t* cursor, note_t* notes) {
+    while (!cursor->done) {
+        int count = cursor_scan(cursor, notes);
+        if (count > 0) {
+            return count;
+        }
+        if (count == 0 || !cursor->recover) {
+            cursor->done = true;
+        }
+    }
+    return 0;
+}
+
+// Upper bound on the up-front reservation (1.5 MiB of notes)
+#define PARSE_RESERVE_MAX_NOTES (1 << 16)
+
+note_array_t parse_music(const char* input) { return parse_music_arena(input, NULL); }
+
+note_array_t parse_music_arena(const char* input, arena_t* arena) { return parse_music_diagnose(input, arena, NULL); }
+
+note_array_t parse_music_diagnose(const char* input, arena_t* arena, parse_diagnostic_t* error) {
+    note_array_t array;
+    parse_cursor_t cursor;
+    note_t notes[MAX_CHORD_SIZE];
+    int count;
+
+    note_array_init_arena(&array, arena);
+    if (input) {
+        // Every note takes at least one character and is usually followed by a space. Long scores
+        // start from a bounded estimate and grow by doubling.
+        // A failed reservation is not an error yet: push retries from its own, smaller size.
+        size_t estimate = strlen(input) / 2 + 1;
+        note_array_reserve(&array, estimate < PARSE_RESERVE_MAX_NOTES ? (int)estimate : PARSE_RESERVE_MAX_NOTES);
+    }
+
+    parse_cursor_init(&cursor, input);
+    while ((count = parse_cursor_next(&cursor, notes)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (!note_array_push(&array, notes[i])) {
+                // Keep the notes parsed so far and report where the score was cut off
+                scan_error_t oom = {.kind = PARSE_ERROR_OUT_OF_MEMORY, .at = cursor.pos, .resume = cursor.pos};
+                report_error(&cursor, &oom);
+                cursor.done = true;
                 break;
             }
-
-            note.instrument = current_instrument;
-            note.chord_id = 0;
-            note_array_push(&array, note);
         }
     }
 
+    note_array_shrink_to_fit(&array); // Give back the unused part of the estimate
+    if (error) {
+        *error = cursor.error;
+    }
     return array;
 }
 
+int parse_check(const char* input, parse_diagnostic_t* diagnostics, int max_diagnostics) {
+    parse_cursor_t cursor;
+    note_t notes[MAX_CHORD_SIZE];
+
+    parse_cursor_init(&cursor, input);
+    cursor.recover = true;
+    cursor.diagnostics = diagnostics;
+    cursor.max_diagnostics = diagnostics ? max_diagnostics : 0;
+
+    // Every error and warning reaches diagnostics through report_error
+    while (parse_cursor_next(&cursor, notes) > 0) {
+        continue;
+    }
+    return cursor.error_count;
+}
+
+static const char* const parse_error_strings[NUM_PARSE_ERRORS] = {
+    [PARSE_OK] = "No error",
+    [PARSE_ERROR_UNEXPECTED_CHARACTER] = "Unexpected character",
+    [PARSE_ERROR_INVALID_DURATION] = "Invalid note value",
+    [PARSE_ERROR_CHORD_TOO_LARGE] = "Chord has too many notes",
+    [PARSE_ERROR_UNTERMINATED_CHORD] = "Chord is missing its '>'",
+    [PARSE_ERROR_UNTERMINATED_INSTRUMENT] = "Instrument is missing its ']'",
+    [PARSE_ERROR_UNKNOWN_INSTRUMENT] = "Unknown instrument",
+    [PARSE_ERROR_UNTERMINATED_TRACK] = "Track is missing its '}'",
+    [PARSE_ERROR_TOO_MANY_TRACKS] = "Too many tracks",
+    [PARSE_ERROR_OUT_OF_MEMORY] = "Out of memory",
+};
+
+const char* parse_error_string(parse_error_kind_t kind) {
+    return (unsigned)kind < NUM_PARSE_ERRORS ? parse_error_strings[kind] : "Unknown error";
+}
+
 // ============================================================================
 // MEMORY MANAGEMENT
 // ============================================================================
 
 void free_note_array(note_array_t* array) {
     if (array && array->data) {
-        free(array->data);
-        array->data = NULL;
-        array->count = 0;
-        array->capacity = 0;
+        note_array_free(array);
     }
 }
 
@@ -2,6 +2,7 @@
 #define PARSER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "array.h"
@@ -19,10 +20,11 @@ typedef struct {
     char note_name; // 'c', 'd', 'e', 'f', 'g', 'a', 'b', 'r' (lowercase)
     int8_t accidental; // -1 for flat(f), 0 for natural, +1 for sharp(s)
     int8_t octave_shift; // relative to reference: 0, +1, -1, +2, etc.
-    int8_t value; // 1, 2, 4, 8, 16, etc. (note value)
+    uint8_t value; // 1, 2, 4, 8, 16, etc. up to 128 (note value)
     bool dotted; // true if this is a dotted note (1.5x duration)
     int8_t tuplet; // 0 = normal, 3 = triplet, 5 = quintuplet, etc.
     int16_t chord_id; // 0 = single note, >0 = chord identifier
+    uint8_t track; // Score track ({name} markers), each with its own timeline; 0 = the unnamed default
     const instrument_t* instrument; // Instrument assignment from parsing
 } note_t;
 
@@ -41,6 +43,62 @@ typedef struct {
 // Define note array type
 DEFINE_ARRAY_TYPE(note, note_t)
 
+#define MAX_CHORD_SIZE 8 // Most notes parse_cursor_next can yield at once
+#define MAX_INSTRUMENT_NAME 31 // Longest name inside [instrument]
+#define MAX_SCORE_TRACKS 16 // Distinct {name} tracks in one score, the unnamed default included
+
+// What stopped (or, when recovering, was skipped by) the parser
+typedef enum {
+    PARSE_OK = 0,
+    PARSE_ERROR_UNEXPECTED_CHARACTER, // Not the start of a note, chord, [instrument] or {track}
+    PARSE_ERROR_INVALID_DURATION, // Note value not a power of two from 1 to 128
+    PARSE_ERROR_CHORD_TOO_LARGE, // More than MAX_CHORD_SIZE notes
+    PARSE_ERROR_UNTERMINATED_CHORD, // '<' without '>'
+    PARSE_ERROR_UNTERMINATED_INSTRUMENT, // '[' without ']'
+    PARSE_ERROR_UNKNOWN_INSTRUMENT, // Name not in the registry (or too long): a warning, the default is used
+    PARSE_ERROR_UNTERMINATED_TRACK, // '{' without '}'
+    PARSE_ERROR_TOO_MANY_TRACKS, // More than MAX_SCORE_TRACKS: a warning, the notes stay on the current track
+    PARSE_ERROR_OUT_OF_MEMORY, // The note array could not grow, the score is cut off here
+    NUM_PARSE_ERRORS,
+} parse_error_kind_t;
+
+typedef struct {
+    parse_error_kind_t kind;
+    int line; // 1-based
+    int column; // 1-based, in bytes from the start of the line
+    size_t offset; // Bytes from the start of the input
+} parse_diagnostic_t;
+
+// Pull-based parser position: yields the score one note or chord at a time without allocating.
+// The input string must stay valid while the cursor is in use.
+typedef struct {
+    const char* pos;
+    const instrument_t* instrument; // Current [instrument] selection
+    int last_duration;
+    int chord_counter;
+
+    // === Tracks ({name} switches; each keeps its own instrument and last duration) ===
+    int track;
+    int num_tracks; // Tracks seen so far, the unnamed default included
+    const char* track_names[MAX_SCORE_TRACKS]; // Into the input, track_name_lengths[t] bytes
+    size_t track_name_lengths[MAX_SCORE_TRACKS];
+    const instrument_t* track_instrument[MAX_SCORE_TRACKS]; // Saved selections of the inactive tracks
+    int track_last_duration[MAX_SCORE_TRACKS];
+
+    bool done; // End of input or parse error
+    bool recover; // Skip a bad token and carry on instead of stopping (set after init)
+    int error_count; // Warnings included
+    parse_diagnostic_t error; // Most recent error or warning, kind PARSE_OK if none
+    parse_diagnostic_t* diagnostics; // Optional: receives the first max_diagnostics (set after init)
+    int max_diagnostics;
+
+    // Lines are counted only when an error is located, resuming from the previous one
+    const char* input;
+    const char* line_start;
+    const char* line_scanned;
+    int line;
+} parse_cursor_t;
+
 // ============================================================================
 // STANDARD DEFINITIONS
 // ============================================================================
@@ -91,8 +149,27 @@ extern const temperament_t werckmeister3_temperament;
 note_t parse_note(const char** input_pos, int* last_duration);
 note_t parse_note_without_duration(const char** input_pos);
 void parse_duration_and_modifiers(const char** input_pos, int* last_duration, note_t* notes, int note_count);
-note_t* parse_chord(const char** input_pos, int* chord_size, int* last_duration);
+bool parse_chord(const char** input_pos, note_t* chord_notes, int* chord_size, int* last_duration);
 note_array_t parse_music(const char* input);
+note_array_t parse_music_arena(const char* input, arena_t* arena); // Array storage from arena (or heap if NULL)
+
+// parse_music_arena that also reports why it stopped: the notes before the first error, with the
+// error in *error (kind PARSE_OK for a clean score). Warnings do not stop the parse, but the last
+// one is reported if there was no error.
+note_array_t parse_music_diagnose(const char* input, arena_t* arena, parse_diagnostic_t* error);
+
+// Validate a score in one pass without building notes: recovers past every error, stores the
+// first max_diagnostics of them (warnings included) and returns how many there were (0 for a clean score)
+int parse_check(const char* input, parse_diagnostic_t* diagnostics, int max_diagnostics);
+
+const char* parse_error_string(parse_error_kind_t kind);
+
+// Streaming parser: parse_cursor_next writes the next note or chord (up to MAX_CHORD_SIZE
+// notes) and returns how many notes it wrote, 0 once the score is exhausted or, unless
+// cursor->recover is set, at the first error (see cursor->error). Warnings are recorded there
+// too but never stop it.
+void parse_cursor_init(parse_cursor_t* cursor, const char* input);
+int parse_cursor_next(parse_cursor_t* cursor, note_t* notes);
 
 // Note utility functions
 bool is_valid_note_name(char c);
@@ -100,6 +177,7 @@ bool is_rest(const note_t* note);
 bool is_dotted(const note_t* note);
 bool is_tuplet(const note_t* note);
 float get_tuplet_ratio(int tuplet);
+void get_tuplet_fraction(int tuplet, int* numerator, int* denominator); // Exact form of get_tuplet_ratio
 
 // Music theory functions
 int note_name_to_semitone(char note_name);
@@ -1,23 +1,36 @@
 #include "pw_driver.h"
 #include <pipewire/pipewire.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/param.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include "rt_log.h"
+#include "rt_stats.h"
 
 // ============================================================================
 // PIPEWIRE TYPES
 // ============================================================================
 
+#define PW_DRIVER_QUANTUM 256 // Frames per cycle we ask the graph for (node.latency)
+#define PW_DRIVER_MAX_QUANTUM 8192 // Largest graph quantum we size buffers for
+#define PW_DRIVER_BUFFERS 2 // Shared buffers: one being played while the next is rendered
+#define PW_DRIVER_LATENCY_RATE 48000 // Rate the node.latency hint is expressed in for AUDIO_RATE_NATIVE
+#define PW_DRIVER_NEGOTIATE_TIMEOUT_MS 2000 // How long format() waits for the graph to fix the format
+
 typedef struct {
     struct pw_main_loop *loop;
     struct pw_context *context;
     struct pw_core *core;
     struct pw_stream *stream;
+    struct spa_source *log_timer;
     audio_callback_t callback;
-    void *user_data;
-    bool playing;
+    audio_format_t format;
+    bool format_ready; // The graph has fixed the format (main loop thread only)
+    void *user_data; // Published to the process thread by the release store to playing
+    atomic_bool playing; // Written by the control thread (play/stop/resume) and the process thread
 } pw_audio_context_t;
 
 // ============================================================================
@@ -39,8 +52,29 @@ void pw_driver_setup_signals(void) {
     signal(SIGINT, signal_handler);
 }
 
+#if MUSICBOX_RT_LOG
+#define LOG_DRAIN_INTERVAL_NS 50000000  // Print real-time log records every 50ms
+
+static void on_log_timer(void *data, uint64_t expirations) {
+    (void)data;
+    (void)expirations;
+    rt_log_drain();
+}
+#endif
+
 void pw_driver_run_main_loop(void *context) {
     pw_audio_context_t *ctx = (pw_audio_context_t*)context;
+
+#if MUSICBOX_RT_LOG
+    // Drain the callback's log ring from the main thread while the loop runs
+    struct pw_loop *loop = pw_main_loop_get_loop(ctx->loop);
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = LOG_DRAIN_INTERVAL_NS};
+    if (!ctx->log_timer) {
+        ctx->log_timer = pw_loop_add_timer(loop, on_log_timer, ctx);
+    }
+    pw_loop_update_timer(loop, ctx->log_timer, &interval, &interval, false);
+#endif
+
     pw_main_loop_run(ctx->loop);
 }
 
@@ -52,23 +86,39 @@ static void on_process(void *userdata) {
     pw_audio_context_t *ctx = userdata;
     struct pw_buffer *b;
     struct spa_buffer *buf;
-    int16_t *samples;
-    uint32_t n_samples;
+    void *samples;
+    uint32_t stride = (uint32_t)audio_frame_size(&ctx->format);
+    uint32_t n_frames;
 
     if ((b = pw_stream_dequeue_buffer(ctx->stream)) == NULL) {
-        printf("Out of buffers\n");
+        RT_LOG(RT_LOG_OUT_OF_BUFFERS, 0, 0);
+        RT_STATS_OUT_OF_BUFFERS();
         return;
     }
 
     buf = b->buffer;
     samples = buf->datas[0].data;
-    n_samples = buf->datas[0].maxsize / sizeof(int16_t);
+    if (samples == NULL) {
+        pw_stream_queue_buffer(ctx->stream, b);
+        return;
+    }
 
-    if (ctx->playing && ctx->callback) {
-        // Call our callback to fill the buffer
-        bool continue_playing = ctx->callback(samples, n_samples, ctx->user_data);
+    // Render straight into the mapped buffer, and only the quantum the graph asked for:
+    // maxsize is sized for the largest quantum, filling it all would add latency
+    n_frames = buf->datas[0].maxsize / stride;
+#if PW_CHECK_VERSION(0, 3, 49)
+    if (b->requested > 0 && b->requested < n_frames) {
+        n_frames = (uint32_t)b->requested;
+    }
+#endif
+
+    if (atomic_load_explicit(&ctx->playing, memory_order_acquire) && ctx->callback) {
+        // Call our callback to fill the buffer, timing it against the quantum's playback time
+        uint64_t render_start = RT_STATS_NOW();
+        bool continue_playing = ctx->callback(samples, n_frames, &ctx->format, ctx->user_data);
+        RT_STATS_QUANTUM(n_frames, ctx->format.sample_rate, RT_STATS_NOW() - render_start);
         if (!continue_playing) {
-            ctx->playing = false;
+            atomic_store_explicit(&ctx->playing, false, memory_order_release);
             ctx->user_data = NULL;  // Callback finished the song
 
             // PipeWire-specific: tell main loop to quit
@@ -78,22 +128,70 @@ static void on_process(void *userdata) {
         }
     } else {
         // Fill with silence
-        memset(samples, 0, n_samples * sizeof(int16_t));
+        memset(samples, 0, n_frames * stride);
     }
 
     buf->datas[0].chunk->offset = 0;
-    buf->datas[0].chunk->stride = sizeof(int16_t);
-    buf->datas[0].chunk->size = n_samples * sizeof(int16_t);
+    buf->datas[0].chunk->stride = stride;
+    buf->datas[0].chunk->size = n_frames * stride;
 
     pw_stream_queue_buffer(ctx->stream, b);
 }
 
+// Once the format is fixed, adopt its rate and ask for buffers laid out exactly as we render
+// them: one interleaved block with our stride, big enough for the largest quantum so `requested`
+// always fits
+static void on_param_changed(void *userdata, uint32_t id, const struct spa_pod *param) {
+    pw_audio_context_t *ctx = userdata;
+    if (param == NULL || id != SPA_PARAM_Format) {
+        return;
+    }
+
+    struct spa_audio_info_raw negotiated;
+    spa_zero(negotiated);
+    if (spa_format_audio_raw_parse(param, &negotiated) >= 0 && negotiated.rate > 0) {
+        ctx->format.sample_rate = negotiated.rate;
+    }
+    ctx->format_ready = ctx->format.sample_rate != AUDIO_RATE_NATIVE;
+
+    int32_t stride = (int32_t)audio_frame_size(&ctx->format);
+    uint8_t buffer[1024];
+    struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+    const struct spa_pod *params[1];
+
+    params[0] = spa_pod_builder_add_object(&b,
+        SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+        SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(PW_DRIVER_BUFFERS, 1, 8),
+        SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
+        SPA_PARAM_BUFFERS_size, SPA_POD_CHOICE_RANGE_Int(stride * PW_DRIVER_MAX_QUANTUM,
+                                                         stride * PW_DRIVER_QUANTUM,
+                                                         stride * PW_DRIVER_MAX_QUANTUM),
+        SPA_PARAM_BUFFERS_stride, SPA_POD_Int(stride),
+        SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(1 << SPA_DATA_MemPtr | 1 << SPA_DATA_MemFd));
+
+    pw_stream_update_params(ctx->stream, params, 1);
+}
+
 static const struct pw_stream_events stream_events = {
     PW_VERSION_STREAM_EVENTS,
+    .param_changed = on_param_changed,
     .process = on_process,
 };
 
-static void* pipewire_init(uint32_t sample_rate, audio_callback_t callback, int *error) {
+static enum spa_audio_format to_spa_format(audio_sample_format_t format) {
+    switch (format) {
+        case AUDIO_FORMAT_S32: return SPA_AUDIO_FORMAT_S32;
+        case AUDIO_FORMAT_F32: return SPA_AUDIO_FORMAT_F32;
+        default: return SPA_AUDIO_FORMAT_S16;
+    }
+}
+
+static void* pipewire_init(const audio_format_t *format, audio_callback_t callback, int *error) {
+    if (format->channels < 1 || format->channels > AUDIO_MAX_CHANNELS) {
+        *error = 2;
+        return NULL;
+    }
+
     pw_audio_context_t *ctx = calloc(1, sizeof(pw_audio_context_t));
     if (!ctx) {
         *error = 1;
@@ -107,17 +205,22 @@ static void* pipewire_init(uint32_t sample_rate, audio_callback_t callback, int
     ctx->context = pw_context_new(pw_main_loop_get_loop(ctx->loop), NULL, 0);
     ctx->core = pw_context_connect(ctx->context, NULL, 0);
     ctx->callback = callback;
-    ctx->playing = false;
+    ctx->format = *format;
+    atomic_init(&ctx->playing, false);
+
+    // Create stream, suggesting the quantum we render best at
+    struct pw_properties *props = pw_properties_new(
+        PW_KEY_MEDIA_TYPE, "Audio",
+        PW_KEY_MEDIA_CATEGORY, "Playback",
+        PW_KEY_MEDIA_ROLE, "Music",
+        NULL);
+    pw_properties_setf(props, PW_KEY_NODE_LATENCY, "%u/%u", PW_DRIVER_QUANTUM,
+                       format->sample_rate != AUDIO_RATE_NATIVE ? format->sample_rate : PW_DRIVER_LATENCY_RATE);
 
-    // Create stream
     ctx->stream = pw_stream_new_simple(
         pw_main_loop_get_loop(ctx->loop),
         "Audio Test",
-        pw_properties_new(
-            PW_KEY_MEDIA_TYPE, "Audio",
-            PW_KEY_MEDIA_CATEGORY, "Playback",
-            PW_KEY_MEDIA_ROLE, "Music",
-            NULL),
+        props,
         &stream_events,
         ctx);
 
@@ -126,11 +229,22 @@ static void* pipewire_init(uint32_t sample_rate, audio_callback_t callback, int
     struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
     const struct spa_pod *params[1];
 
-    params[0] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat,
-        &SPA_AUDIO_INFO_RAW_INIT(
-            .format = SPA_AUDIO_FORMAT_S16,
-            .channels = 1,
-            .rate = sample_rate));
+    // Offer exactly what the callback renders, so the graph needs no format conversion pass.
+    // AUDIO_RATE_NATIVE leaves the rate out, so the graph gives us its own and never resamples.
+    struct spa_audio_info_raw info = SPA_AUDIO_INFO_RAW_INIT(
+        .format = to_spa_format(format->format),
+        .channels = format->channels,
+        .rate = format->sample_rate);
+    if (format->channels == 1) {
+        info.position[0] = SPA_AUDIO_CHANNEL_MONO;
+    } else if (format->channels == 2) {
+        info.position[0] = SPA_AUDIO_CHANNEL_FL;
+        info.position[1] = SPA_AUDIO_CHANNEL_FR;
+    } else {
+        info.flags |= SPA_AUDIO_FLAG_UNPOSITIONED;
+    }
+
+    params[0] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &info);
 
     pw_stream_connect(ctx->stream, PW_DIRECTION_OUTPUT, PW_ID_ANY,
                       PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS,
@@ -143,20 +257,20 @@ static void* pipewire_init(uint32_t sample_rate, audio_callback_t callback, int
 static void pw_play(void *context, void *user_data) {
     pw_audio_context_t *ctx = context;
     ctx->user_data = user_data;
-    ctx->playing = true;
+    atomic_store_explicit(&ctx->playing, true, memory_order_release);
     printf("Started playback\n");
 }
 
 static void pw_stop(void *context) {
     pw_audio_context_t *ctx = context;
-    ctx->playing = false;
+    atomic_store_explicit(&ctx->playing, false, memory_order_release);
     printf("Stopped playback\n");
 }
 
 static void pw_resume(void *context) {
     pw_audio_context_t *ctx = context;
     if (ctx->user_data) {
-        ctx->playing = true;
+        atomic_store_explicit(&ctx->playing, true, memory_order_release);
         printf("Resumed playback\n");
     }
 }
@@ -164,6 +278,7 @@ static void pw_resume(void *context) {
 static void pw_cleanup(void *context) {
     pw_audio_context_t *ctx = context;
 
+    if (ctx->log_timer) pw_loop_destroy_source(pw_main_loop_get_loop(ctx->loop), ctx->log_timer);
     if (ctx->stream) pw_stream_destroy(ctx->stream);
     if (ctx->core) pw_core_disconnect(ctx->core);
     if (ctx->context) pw_context_destroy(ctx->context);
@@ -173,10 +288,25 @@ static void pw_cleanup(void *context) {
     pw_deinit();
 }
 
+// Run the loop until the graph fixes our format, so the caller can sequence for its rate
+static const audio_format_t* pw_format(void *context) {
+    pw_audio_context_t *ctx = context;
+    struct pw_loop *loop = pw_main_loop_get_loop(ctx->loop);
+
+    pw_loop_enter(loop);
+    for (int waited = 0; !ctx->format_ready && running && waited < PW_DRIVER_NEGOTIATE_TIMEOUT_MS; waited += 10) {
+        pw_loop_iterate(loop, 10);
+    }
+    pw_loop_leave(loop);
+
+    return ctx->format_ready ? &ctx->format : NULL;
+}
+
 static const char* pw_strerror(int error_code) {
     switch (error_code) {
         case 0: return "Success";
         case 1: return "Memory allocation failed";
+        case 2: return "Unsupported channel count";
         default: return "Unknown error";
     }
 }
@@ -188,5 +318,6 @@ const audio_driver_t pipewire_driver = {
     .stop = pw_stop,
     .resume = pw_resume,
     .cleanup = pw_cleanup,
-    .strerror = pw_strerror
+    .strerror = pw_strerror,
+    .format = pw_format
 };
\ No newline at end of file
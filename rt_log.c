@@ -0,0 +1,119 @@
+#include "rt_log.h"
+
+#if MUSICBOX_RT_LOG
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+// ============================================================================
+// LOCK-FREE MPSC RING
+// ============================================================================
+
+// Bounded ring with a sequence number per slot, so several render threads (see
+// multitrack.c) can log concurrently. Producers claim a position by CAS on head;
+// the single consumer owns tail. A slot at position pos is free when its sequence
+// equals pos and holds a record when it equals pos + 1.
+//
+// Sequences are stored relative to the slot index so the zero-initialized ring is
+// already in its empty state (slot i free for position i).
+typedef struct {
+    atomic_uint sequence;
+    rt_log_record_t record;
+} rt_log_slot_t;
+
+#define RT_LOG_MASK (RT_LOG_CAPACITY - 1)
+
+static rt_log_slot_t ring[RT_LOG_CAPACITY];
+static atomic_uint head;
+static unsigned tail; // Consumer only
+static atomic_uint dropped;
+
+static unsigned slot_sequence(unsigned pos) {
+    return atomic_load_explicit(&ring[pos & RT_LOG_MASK].sequence, memory_order_acquire) + (pos & RT_LOG_MASK);
+}
+
+static void set_slot_sequence(unsigned pos, unsigned sequence) {
+    atomic_store_explicit(&ring[pos & RT_LOG_MASK].sequence, sequence - (pos & RT_LOG_MASK), memory_order_release);
+}
+
+bool rt_log_write(rt_log_code_t code, int32_t arg, uint64_t sample) {
+    unsigned pos = atomic_load_explicit(&head, memory_order_relaxed);
+
+    for (;;) {
+        int diff = (int)(slot_sequence(pos) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break; // Claimed the slot
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return false; // Ring full
+        } else {
+            pos = atomic_load_explicit(&head, memory_order_relaxed); // Another producer won, retry
+        }
+    }
+
+    rt_log_record_t* record = &ring[pos & RT_LOG_MASK].record;
+    record->code = code;
+    record->arg = arg;
+    record->sample = sample;
+
+    // Publish the record only after it has been fully written
+    set_slot_sequence(pos, pos + 1);
+    return true;
+}
+
+// ============================================================================
+// MAIN THREAD DRAIN
+// ============================================================================
+
+static void print_record(const rt_log_record_t* record) {
+    unsigned long sample = (unsigned long)record->sample;
+
+    switch (record->code) {
+    case RT_LOG_EVENT_ACTIVATED:
+        printf("Activated event %d at sample %lu\n", record->arg, sample);
+        break;
+    case RT_LOG_EVENT_COMPLETED:
+        printf("Removing completed ADSR event at sample %lu\n", sample);
+        break;
+    case RT_LOG_EVENT_INAUDIBLE:
+        printf("Removing inaudible event at sample %lu\n", sample);
+        break;
+    case RT_LOG_EVENT_STOLEN:
+        printf("Stealing voice of event %d at sample %lu\n", record->arg, sample);
+        break;
+    case RT_LOG_EVENT_DROPPED:
+        printf("Dropped event %d at sample %lu (no free voice)\n", record->arg, sample);
+        break;
+    case RT_LOG_SONG_COMPLETE:
+        printf("Song complete, marking as finished\n");
+        break;
+    case RT_LOG_OUT_OF_BUFFERS:
+        printf("Out of buffers\n");
+        break;
+    default:
+        printf("Unknown log record %u (arg %d) at sample %lu\n", record->code, record->arg, sample);
+        break;
+    }
+}
+
+int rt_log_drain(void) {
+    int count = 0;
+
+    while ((int)(slot_sequence(tail) - (tail + 1)) >= 0) {
+        print_record(&ring[tail & RT_LOG_MASK].record);
+
+        // Release the slot back to the producers for the next lap
+        set_slot_sequence(tail, tail + RT_LOG_CAPACITY);
+        tail++;
+        count++;
+    }
+
+    return count;
+}
+
+uint32_t rt_log_dropped(void) { return atomic_load_explicit(&dropped, memory_order_relaxed); }
+
+#endif // MUSICBOX_RT_LOG
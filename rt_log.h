@@ -0,0 +1,64 @@
+#ifndef RT_LOG_H
+#define RT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ============================================================================
+// REAL-TIME SAFE LOGGING
+// ============================================================================
+
+// The audio callback must never call printf: stdio takes locks and may block on
+// the terminal. Instead it pushes fixed-size records into a lock-free
+// multi-producer/single-consumer ring that the main thread drains and prints.
+//
+// Producers: any number of threads (the audio callback, multitrack render workers) may
+// write at once; none blocks, but a writer preempted between claiming its slot and
+// filling it holds back the drain of later records until it finishes.
+//
+// Build with -DMUSICBOX_RT_LOG=0 (e.g. for the Pico) to strip logging entirely.
+#ifndef MUSICBOX_RT_LOG
+#define MUSICBOX_RT_LOG 1
+#endif
+
+#define RT_LOG_CAPACITY 1024 // Records in the ring (must be a power of two)
+
+typedef enum {
+    RT_LOG_EVENT_ACTIVATED, // arg = event index
+    RT_LOG_EVENT_COMPLETED, // ADSR event finished its release
+    RT_LOG_EVENT_INAUDIBLE, // Event decayed below AUDIBLE_THRESHOLD
+    RT_LOG_EVENT_STOLEN, // arg = event index of the voice faded out for a new event
+    RT_LOG_EVENT_DROPPED, // arg = event index that found no free voice
+    RT_LOG_SONG_COMPLETE,
+    RT_LOG_OUT_OF_BUFFERS, // Audio driver had no buffer to fill
+} rt_log_code_t;
+
+typedef struct {
+    uint32_t code; // rt_log_code_t
+    int32_t arg; // Code-specific argument
+    uint64_t sample; // Sample index at which the record was written
+} rt_log_record_t;
+
+#if MUSICBOX_RT_LOG
+
+// Producer side (audio and render threads): never blocks, drops the record when the ring is full
+bool rt_log_write(rt_log_code_t code, int32_t arg, uint64_t sample);
+
+// Consumer side (main thread only): print all pending records, returns number printed
+int rt_log_drain(void);
+
+// Number of records dropped because the ring was full
+uint32_t rt_log_dropped(void);
+
+#define RT_LOG(code, arg, sample) rt_log_write((code), (arg), (sample))
+
+#else
+
+#define RT_LOG(code, arg, sample) ((void)0)
+
+static inline int rt_log_drain(void) { return 0; }
+static inline uint32_t rt_log_dropped(void) { return 0; }
+
+#endif // MUSICBOX_RT_LOG
+
+#endif // RT_LOG_H
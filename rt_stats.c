@@ -0,0 +1,166 @@
+#include "rt_stats.h"
+
+#if MUSICBOX_RT_STATS
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+// ============================================================================
+// COUNTERS
+// ============================================================================
+
+// Written with relaxed atomics: the audio thread never waits, and a reader only
+// needs each counter to be torn-free, not a consistent cut across all of them.
+static atomic_ullong quanta;
+static atomic_ullong frames_total;
+static atomic_ullong out_of_buffers;
+static atomic_ullong overruns;
+static atomic_ullong underruns;
+static atomic_ullong culled;
+static atomic_ullong total_render_ns;
+static atomic_ullong max_render_ns;
+static atomic_uint max_voices;
+static atomic_uint render_time_hist[RT_STATS_TIME_BUCKETS];
+static atomic_uint load_hist[RT_STATS_LOAD_BUCKETS];
+static atomic_uint quantum_hist[RT_STATS_QUANTUM_BUCKETS];
+static atomic_uint voice_hist[RT_STATS_VOICE_BUCKETS];
+
+// Index of the highest set bit (0 for 0 and 1)
+static int log2_bucket(uint64_t value, int num_buckets) {
+    int bucket = value > 1 ? 63 - __builtin_clzll(value) : 0;
+    return bucket < num_buckets ? bucket : num_buckets - 1;
+}
+
+// Single writer per counter, so a load/store pair is enough to keep the maximum
+static void update_max(atomic_ullong* max, uint64_t value) {
+    if (value > atomic_load_explicit(max, memory_order_relaxed)) {
+        atomic_store_explicit(max, value, memory_order_relaxed);
+    }
+}
+
+uint64_t rt_stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void rt_stats_record_quantum(uint32_t frames, uint32_t sample_rate, uint64_t render_ns) {
+    atomic_fetch_add_explicit(&quanta, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&frames_total, frames, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total_render_ns, render_ns, memory_order_relaxed);
+    update_max(&max_render_ns, render_ns);
+
+    atomic_fetch_add_explicit(&render_time_hist[log2_bucket(render_ns, RT_STATS_TIME_BUCKETS)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&quantum_hist[log2_bucket(frames, RT_STATS_QUANTUM_BUCKETS)], 1, memory_order_relaxed);
+
+    // Share of the quantum's own playback time spent rendering it
+    if (frames > 0 && sample_rate > 0) {
+        uint64_t period_ns = (uint64_t)frames * 1000000000ull / sample_rate;
+        uint64_t percent = period_ns > 0 ? render_ns * 100 / period_ns : 0;
+        uint64_t bucket = percent / 10;
+        if (bucket >= RT_STATS_LOAD_BUCKETS) {
+            bucket = RT_STATS_LOAD_BUCKETS - 1;
+        }
+        atomic_fetch_add_explicit(&load_hist[bucket], 1, memory_order_relaxed);
+        if (render_ns > period_ns) {
+            atomic_fetch_add_explicit(&overruns, 1, memory_order_relaxed);
+        }
+    }
+}
+
+void rt_stats_record_voices(int voices) {
+    uint32_t count = voices > 0 ? (uint32_t)voices : 0;
+    if (count > atomic_load_explicit(&max_voices, memory_order_relaxed)) {
+        atomic_store_explicit(&max_voices, count, memory_order_relaxed);
+    }
+    uint32_t bucket = count < RT_STATS_VOICE_BUCKETS ? count : RT_STATS_VOICE_BUCKETS - 1;
+    atomic_fetch_add_explicit(&voice_hist[bucket], 1, memory_order_relaxed);
+}
+
+void rt_stats_record_out_of_buffers(void) { atomic_fetch_add_explicit(&out_of_buffers, 1, memory_order_relaxed); }
+
+void rt_stats_record_underrun(void) { atomic_fetch_add_explicit(&underruns, 1, memory_order_relaxed); }
+
+void rt_stats_record_culled(void) { atomic_fetch_add_explicit(&culled, 1, memory_order_relaxed); }
+
+// ============================================================================
+// MAIN THREAD READOUT
+// ============================================================================
+
+void rt_stats_snapshot(rt_stats_t* out) {
+    out->quanta = atomic_load_explicit(&quanta, memory_order_relaxed);
+    out->frames = atomic_load_explicit(&frames_total, memory_order_relaxed);
+    out->out_of_buffers = atomic_load_explicit(&out_of_buffers, memory_order_relaxed);
+    out->overruns = atomic_load_explicit(&overruns, memory_order_relaxed);
+    out->underruns = atomic_load_explicit(&underruns, memory_order_relaxed);
+    out->culled = atomic_load_explicit(&culled, memory_order_relaxed);
+    out->total_render_ns = atomic_load_explicit(&total_render_ns, memory_order_relaxed);
+    out->max_render_ns = atomic_load_explicit(&max_render_ns, memory_order_relaxed);
+    out->max_voices = atomic_load_explicit(&max_voices, memory_order_relaxed);
+    for (int i = 0; i < RT_STATS_TIME_BUCKETS; i++) {
+        out->render_time[i] = atomic_load_explicit(&render_time_hist[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < RT_STATS_LOAD_BUCKETS; i++) {
+        out->load[i] = atomic_load_explicit(&load_hist[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < RT_STATS_QUANTUM_BUCKETS; i++) {
+        out->quantum[i] = atomic_load_explicit(&quantum_hist[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < RT_STATS_VOICE_BUCKETS; i++) {
+        out->voices[i] = atomic_load_explicit(&voice_hist[i], memory_order_relaxed);
+    }
+}
+
+void rt_stats_print(void) {
+    rt_stats_t stats;
+    rt_stats_snapshot(&stats);
+    if (stats.quanta == 0) {
+        return;
+    }
+
+    printf("Render stats: %llu quanta, %llu frames, %llu overruns, %llu underruns, %llu out of buffers\n",
+           (unsigned long long)stats.quanta, (unsigned long long)stats.frames, (unsigned long long)stats.overruns,
+           (unsigned long long)stats.underruns, (unsigned long long)stats.out_of_buffers);
+    printf("  Render time: mean %.1f us, max %.1f us; peak voices %u\n",
+           stats.total_render_ns / 1000.0 / stats.quanta, stats.max_render_ns / 1000.0, stats.max_voices);
+    if (stats.culled) {
+        printf("  Reduced quality (partials culled for the CPU budget): %llu quanta\n",
+               (unsigned long long)stats.culled);
+    }
+
+    printf("  Render time per quantum:\n");
+    for (int i = 0; i < RT_STATS_TIME_BUCKETS; i++) {
+        if (stats.render_time[i]) {
+            printf("    %10.1f - %10.1f us: %u\n", (1ull << i) / 1000.0, (2ull << i) / 1000.0, stats.render_time[i]);
+        }
+    }
+
+    printf("  Load (render time / playback time):\n");
+    for (int i = 0; i < RT_STATS_LOAD_BUCKETS; i++) {
+        if (stats.load[i]) {
+            if (i == RT_STATS_LOAD_BUCKETS - 1) {
+                printf("    %3d%% and over: %u\n", i * 10, stats.load[i]);
+            } else {
+                printf("    %3d - %3d%%: %u\n", i * 10, i * 10 + 10, stats.load[i]);
+            }
+        }
+    }
+
+    printf("  Quantum size:\n");
+    for (int i = 0; i < RT_STATS_QUANTUM_BUCKETS; i++) {
+        if (stats.quantum[i]) {
+            printf("    %6llu - %6llu frames: %u\n", 1ull << i, (2ull << i) - 1, stats.quantum[i]);
+        }
+    }
+
+    printf("  Peak voices per quantum:\n");
+    for (int i = 0; i < RT_STATS_VOICE_BUCKETS; i++) {
+        if (stats.voices[i]) {
+            printf("    %2d%s: %u\n", i, i == RT_STATS_VOICE_BUCKETS - 1 ? "+" : "", stats.voices[i]);
+        }
+    }
+}
+
+#endif // MUSICBOX_RT_STATS
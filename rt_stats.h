@@ -0,0 +1,89 @@
+#ifndef RT_STATS_H
+#define RT_STATS_H
+
+#include <stdint.h>
+
+// ============================================================================
+// REAL-TIME RENDER INSTRUMENTATION
+// ============================================================================
+
+// Per-quantum render timings, quantum sizes, voice counts and driver underruns,
+// accumulated by the audio thread into lock-free histograms (relaxed atomic
+// counters, no locks or syscalls besides the monotonic clock). The main thread
+// can take a snapshot at any time, e.g. to print it at exit.
+//
+// Build with -DMUSICBOX_RT_STATS=0 to compile the instrumentation out.
+#ifndef MUSICBOX_RT_STATS
+#define MUSICBOX_RT_STATS 1
+#endif
+
+#define RT_STATS_TIME_BUCKETS 32 // Render time: bucket i counts [2^i, 2^(i+1)) ns
+#define RT_STATS_LOAD_BUCKETS 21 // Render time / quantum playback time: 10% steps, last = 200% and over
+#define RT_STATS_QUANTUM_BUCKETS 17 // Quantum size: bucket i counts [2^i, 2^(i+1)) frames
+#define RT_STATS_VOICE_BUCKETS 65 // Peak active voices per quantum, last = 64 and over
+
+typedef struct {
+    uint64_t quanta; // Quanta rendered
+    uint64_t frames; // Frames rendered
+    uint64_t out_of_buffers; // Driver had no buffer to fill
+    uint64_t overruns; // Quanta that took longer to render than to play
+    uint64_t underruns; // Quanta the lookahead ring could not fill completely
+    uint64_t culled; // Quanta rendered with partials culled to stay within the CPU budget
+    uint64_t total_render_ns;
+    uint64_t max_render_ns;
+    uint32_t max_voices;
+    uint32_t render_time[RT_STATS_TIME_BUCKETS];
+    uint32_t load[RT_STATS_LOAD_BUCKETS];
+    uint32_t quantum[RT_STATS_QUANTUM_BUCKETS];
+    uint32_t voices[RT_STATS_VOICE_BUCKETS];
+} rt_stats_t;
+
+#if MUSICBOX_RT_STATS
+
+// Monotonic clock for timing a quantum
+uint64_t rt_stats_now_ns(void);
+
+// Audio thread: one rendered quantum of `frames` at `sample_rate` that took render_ns
+void rt_stats_record_quantum(uint32_t frames, uint32_t sample_rate, uint64_t render_ns);
+
+// Render thread: the most voices that were active at once during the last quantum
+void rt_stats_record_voices(int voices);
+
+// Audio thread: the driver could not get a buffer
+void rt_stats_record_out_of_buffers(void);
+
+// Audio thread: the lookahead ring ran dry and part of the quantum was played as silence
+void rt_stats_record_underrun(void);
+
+// Render thread: the quantum just rendered had partials culled (adaptive quality)
+void rt_stats_record_culled(void);
+
+// Any thread: copy the counters (each is individually consistent)
+void rt_stats_snapshot(rt_stats_t* out);
+
+// Main thread: print a summary and the non-empty histogram buckets
+void rt_stats_print(void);
+
+#define RT_STATS_NOW() rt_stats_now_ns()
+#define RT_STATS_QUANTUM(frames, sample_rate, render_ns) rt_stats_record_quantum((frames), (sample_rate), (render_ns))
+#define RT_STATS_VOICES(voices) rt_stats_record_voices(voices)
+#define RT_STATS_OUT_OF_BUFFERS() rt_stats_record_out_of_buffers()
+#define RT_STATS_UNDERRUN() rt_stats_record_underrun()
+#define RT_STATS_CULLED() rt_stats_record_culled()
+
+#else
+
+// Arguments are still evaluated (and discarded), so values computed only for the stats stay used
+#define RT_STATS_NOW() ((uint64_t)0)
+#define RT_STATS_QUANTUM(frames, sample_rate, render_ns) ((void)(frames), (void)(sample_rate), (void)(render_ns))
+#define RT_STATS_VOICES(voices) ((void)(voices))
+#define RT_STATS_OUT_OF_BUFFERS() ((void)0)
+#define RT_STATS_UNDERRUN() ((void)0)
+#define RT_STATS_CULLED() ((void)0)
+
+static inline void rt_stats_snapshot(rt_stats_t* out) { *out = (rt_stats_t){0}; }
+static inline void rt_stats_print(void) {}
+
+#endif // MUSICBOX_RT_STATS
+
+#endif // RT_STATS_H
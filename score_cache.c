@@ -0,0 +1,339 @@
+#include "score_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// CACHE ENTRIES
+// ============================================================================
+
+typedef struct {
+    uint32_t sample_rate;
+    int tempo_bpm;
+    const key_signature_t* key;
+    const temperament_t* temperament;
+    int transposition;
+    float volume;
+} sequence_params_t;
+
+// A score (text and parsed notes) or one sequencing of it. Scores sit in the hash chains;
+// their sequencings hang off them and are evicted with them. Both kinds share the LRU list.
+struct score_cache_entry {
+    score_cache_entry_t* lru_prev;
+    score_cache_entry_t* lru_next;
+    size_t bytes; // Charged against the budget
+    score_cache_entry_t* score; // Sequencings: the score they came from, NULL for scores
+    score_cache_entry_t* next_sequence; // Scores: first sequencing; sequencings: the next one
+
+    // === Scores ===
+    score_cache_entry_t* chain; // Next score in the bucket
+    uint64_t hash;
+    char* text;
+    size_t length;
+    note_array_t notes;
+
+    // === Sequencings ===
+    sequence_params_t params;
+    event_array_t events;
+};
+
+// ============================================================================
+// HASHING
+// ============================================================================
+
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+static inline uint64_t rotate_left(uint64_t x, int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+// Final avalanche (MurmurHash3's fmix64), so every input bit reaches the bucket index bits
+static uint64_t hash_finish(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Content hash taking 8 bytes per step: one multiply each, so hashing stays far cheaper than
+// parsing (entries are confirmed against the text, so it only has to spread well)
+static uint64_t hash_text(const char* text, size_t length) {
+    uint64_t h = length * HASH_MULTIPLIER;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, text + i, 8);
+        h = (rotate_left(h, 29) ^ word) * HASH_MULTIPLIER;
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        memcpy(&word, text + i, length - i);
+        h = (rotate_left(h, 29) ^ word) * HASH_MULTIPLIER;
+    }
+    return hash_finish(h);
+}
+
+static bool params_equal(const sequence_params_t* a, const sequence_params_t* b) {
+    // Volume by bit pattern, so it matches exactly what was sequenced
+    return a->sample_rate == b->sample_rate && a->tempo_bpm == b->tempo_bpm && a->key == b->key &&
+           a->temperament == b->temperament && a->transposition == b->transposition &&
+           memcmp(&a->volume, &b->volume, sizeof(float)) == 0;
+}
+
+// ============================================================================
+// LRU LIST AND EVICTION
+// ============================================================================
+
+static void lru_unlink(score_cache_t* cache, score_cache_entry_t* entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(score_cache_t* cache, score_cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) {
+        cache->lru_head->lru_prev = entry;
+    } else {
+        cache->lru_tail = entry;
+    }
+    cache->lru_head = entry;
+}
+
+static void lru_touch(score_cache_t* cache, score_cache_entry_t* entry) {
+    if (cache->lru_head != entry) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+    }
+}
+
+static void free_entry(score_cache_t* cache, score_cache_entry_t* entry) {
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->bytes;
+    if (entry->score) {
+        event_array_free(&entry->events);
+    } else {
+        free(entry->text);
+        free_note_array(&entry->notes);
+    }
+    free(entry);
+}
+
+// Remove an entry from the cache; a score takes its sequencings with it
+static void evict(score_cache_t* cache, score_cache_entry_t* entry) {
+    if (entry->score) {
+        score_cache_entry_t** link = &entry->score->next_sequence;
+        while (*link != entry) {
+            link = &(*link)->next_sequence;
+        }
+        *link = entry->next_sequence;
+    } else {
+        score_cache_entry_t** link = &cache->buckets[entry->hash & (SCORE_CACHE_BUCKETS - 1)];
+        while (*link != entry) {
+            link = &(*link)->chain;
+        }
+        *link = entry->chain;
+
+        while (entry->next_sequence) {
+            score_cache_entry_t* sequence = entry->next_sequence;
+            entry->next_sequence = sequence->next_sequence;
+            free_entry(cache, sequence);
+        }
+    }
+    free_entry(cache, entry);
+    cache->evictions++;
+}
+
+// Evict least recently used entries until `bytes` more fit, never evicting `keep`.
+// Returns false if they cannot fit.
+static bool make_room(score_cache_t* cache, size_t bytes, const score_cache_entry_t* keep) {
+    if (bytes > cache->budget) {
+        return false;
+    }
+    while (cache->bytes + bytes > cache->budget && cache->lru_tail && cache->lru_tail != keep) {
+        evict(cache, cache->lru_tail);
+    }
+    return cache->bytes + bytes <= cache->budget;
+}
+
+// ============================================================================
+// LOOKUP
+// ============================================================================
+
+static note_array_t copy_notes(const note_array_t* notes) {
+    note_array_t copy;
+    note_array_init(&copy);
+    if (notes->count > 0 && note_array_reserve(&copy, notes->count)) {
+        memcpy(copy.data, notes->data, (size_t)notes->count * sizeof(note_t));
+        copy.count = notes->count;
+    }
+    return copy;
+}
+
+static event_array_t copy_events(const event_array_t* events) {
+    event_array_t copy;
+    event_array_init(&copy);
+    if (events->count > 0 && event_array_reserve(&copy, events->count)) {
+        memcpy(copy.data, events->data, (size_t)events->count * sizeof(event_t));
+        copy.count = events->count;
+    }
+    return copy;
+}
+
+static score_cache_entry_t* find_score(score_cache_t* cache, const char* score, size_t length, uint64_t hash) {
+    for (score_cache_entry_t* entry = cache->buckets[hash & (SCORE_CACHE_BUCKETS - 1)]; entry;
+         entry = entry->chain) {
+        if (entry->hash == hash && entry->length == length && memcmp(entry->text, score, length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// The score's entry, parsed and inserted on a miss. NULL if it is too large to cache, with the
+// parsed notes handed back in *uncached instead.
+static score_cache_entry_t* get_score(score_cache_t* cache, const char* score, note_array_t* uncached) {
+    size_t length = strlen(score);
+    uint64_t hash = hash_text(score, length);
+
+    score_cache_entry_t* entry = find_score(cache, score, length, hash);
+    if (entry) {
+        cache->parse_hits++;
+        lru_touch(cache, entry);
+        return entry;
+    }
+
+    cache->parse_misses++;
+    note_array_t notes = parse_music(score);
+    size_t bytes = sizeof(score_cache_entry_t) + length + 1 + (size_t)notes.capacity * sizeof(note_t);
+    if (!make_room(cache, bytes, NULL) || !(entry = calloc(1, sizeof(score_cache_entry_t))) ||
+        !(entry->text = malloc(length + 1))) {
+        free(entry);
+        *uncached = notes;
+        return NULL;
+    }
+
+    memcpy(entry->text, score, length + 1);
+    entry->length = length;
+    entry->hash = hash;
+    entry->notes = notes;
+    entry->bytes = bytes;
+    entry->chain = cache->buckets[hash & (SCORE_CACHE_BUCKETS - 1)];
+    cache->buckets[hash & (SCORE_CACHE_BUCKETS - 1)] = entry;
+    cache->bytes += bytes;
+    lru_push_front(cache, entry);
+    return entry;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+score_cache_t* score_cache_create(size_t budget_bytes) {
+    score_cache_t* cache = calloc(1, sizeof(score_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+    cache->budget = budget_bytes;
+    return cache;
+}
+
+note_array_t score_cache_parse(score_cache_t* cache, const char* score) {
+    if (!cache || !score) {
+        return parse_music(score);
+    }
+
+    note_array_t uncached;
+    score_cache_entry_t* entry = get_score(cache, score, &uncached);
+    return entry ? copy_notes(&entry->notes) : uncached;
+}
+
+event_array_t score_cache_sequence(score_cache_t* cache, const char* score, uint32_t sample_rate, int tempo_bpm,
+                                   const key_signature_t* key, const temperament_t* temperament, int transposition,
+                                   float volume) {
+    if (!cache || !score) {
+        note_array_t notes = parse_music(score);
+        event_array_t events = sequence_events(&notes, sample_rate, tempo_bpm, key, temperament, transposition, volume);
+        free_note_array(&notes);
+        return events;
+    }
+
+    note_array_t uncached;
+    score_cache_entry_t* parent = get_score(cache, score, &uncached);
+    if (!parent) {
+        cache->sequence_misses++;
+        event_array_t events =
+            sequence_events(&uncached, sample_rate, tempo_bpm, key, temperament, transposition, volume);
+        free_note_array(&uncached);
+        return events;
+    }
+
+    sequence_params_t params = {.sample_rate = sample_rate,
+                                .tempo_bpm = tempo_bpm,
+                                .key = key,
+                                .temperament = temperament,
+                                .transposition = transposition,
+                                .volume = volume};
+    for (score_cache_entry_t* entry = parent->next_sequence; entry; entry = entry->next_sequence) {
+        if (params_equal(&entry->params, &params)) {
+            cache->sequence_hits++;
+            lru_touch(cache, entry);
+            lru_touch(cache, parent); // A score stays more recent than its sequencings
+            return copy_events(&entry->events);
+        }
+    }
+
+    cache->sequence_misses++;
+    event_array_t events = sequence_events(&parent->notes, sample_rate, tempo_bpm, key, temperament, transposition,
+                                           volume);
+    size_t bytes = sizeof(score_cache_entry_t) + (size_t)events.capacity * sizeof(event_t);
+    score_cache_entry_t* entry;
+    if (!make_room(cache, bytes, parent) || !(entry = calloc(1, sizeof(score_cache_entry_t)))) {
+        return events; // Too large to keep alongside its score
+    }
+
+    entry->score = parent;
+    entry->params = params;
+    entry->events = events;
+    entry->bytes = bytes;
+    entry->next_sequence = parent->next_sequence;
+    parent->next_sequence = entry;
+    cache->bytes += bytes;
+    lru_push_front(cache, entry);
+    lru_touch(cache, parent);
+    return copy_events(&entry->events);
+}
+
+void score_cache_clear(score_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    for (int b = 0; b < SCORE_CACHE_BUCKETS; b++) {
+        while (cache->buckets[b]) {
+            evict(cache, cache->buckets[b]);
+            cache->evictions--; // Not budget pressure
+        }
+    }
+}
+
+void score_cache_destroy(score_cache_t* cache) {
+    score_cache_clear(cache);
+    free(cache);
+}
+
+void score_cache_print_stats(const score_cache_t* cache) {
+    printf("Score cache: %zu of %zu KiB, parse %llu hits / %llu misses, sequence %llu hits / %llu misses, "
+           "%llu evictions\n",
+           cache->bytes / 1024, cache->budget / 1024, (unsigned long long)cache->parse_hits,
+           (unsigned long long)cache->parse_misses, (unsigned long long)cache->sequence_hits,
+           (unsigned long long)cache->sequence_misses, (unsigned long long)cache->evictions);
+}
@@ -0,0 +1,61 @@
+#ifndef SCORE_CACHE_H
+#define SCORE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "parser.h"
+#include "sequencer.h"
+
+// ============================================================================
+// SCORE RESULT CACHE
+// ============================================================================
+
+// Memoizes parse_music by score text and sequence_events by (score, sample rate, tempo, key,
+// temperament, transposition, volume), so re-rendering a score with other parameters skips the
+// parse and repeating a request skips both. Scores are found by a 64-bit content hash and
+// confirmed against a stored copy of the text, so a collision can never return another score's
+// notes. Key and temperament are matched by address (the standard definitions are static).
+//
+// Entries are charged for their text, notes and events against a byte budget; the least
+// recently used are evicted first. Results are returned as copies the caller owns. Not
+// thread-safe: use one cache per thread or serialize the calls.
+
+#define SCORE_CACHE_BUCKETS 256 // Hash chains (power of two)
+
+typedef struct score_cache_entry score_cache_entry_t;
+
+typedef struct {
+    score_cache_entry_t* buckets[SCORE_CACHE_BUCKETS];
+    score_cache_entry_t* lru_head; // Most recently used
+    score_cache_entry_t* lru_tail; // Evicted first
+    size_t budget; // Bytes the entries may hold
+    size_t bytes; // Bytes the entries hold now
+
+    // === Counters ===
+    uint64_t parse_hits;
+    uint64_t parse_misses;
+    uint64_t sequence_hits;
+    uint64_t sequence_misses;
+    uint64_t evictions;
+} score_cache_t;
+
+// Cache holding at most budget_bytes of results, NULL if out of memory
+score_cache_t* score_cache_create(size_t budget_bytes);
+
+// parse_music(score) from the cache, parsed and cached on a miss (free with free_note_array)
+note_array_t score_cache_parse(score_cache_t* cache, const char* score);
+
+// sequence_events of the score's notes from the cache, sequenced (and parsed) on a miss
+// (free with event_array_free, or hand over to a sequencer_state_t)
+event_array_t score_cache_sequence(score_cache_t* cache, const char* score, uint32_t sample_rate, int tempo_bpm,
+                                   const key_signature_t* key, const temperament_t* temperament, int transposition,
+                                   float volume);
+
+// Drop every entry (the counters are kept)
+void score_cache_clear(score_cache_t* cache);
+
+void score_cache_destroy(score_cache_t* cache);
+
+void score_cache_print_stats(const score_cache_t* cache);
+
+#endif // SCORE_CACHE_H
@@ -0,0 +1,218 @@
+#include "score_file.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "instrument.h"
+
+_Static_assert(sizeof(score_file_header_t) == 24, "score_file_header_t layout changed");
+_Static_assert(sizeof(score_event_record_t) == 60, "score_event_record_t layout changed");
+
+// ============================================================================
+// RECORD ENCODING
+// ============================================================================
+
+// Records carry the envelope as plain words so the layout does not depend on union padding
+static void encode_event(const event_t* event, score_event_record_t* record) {
+    memset(record, 0, sizeof(*record));
+    record->start_sample = event->start_sample;
+    record->duration_samples = event->duration_samples;
+    record->release_sample = event->release_sample;
+    record->phase_increment = event->phase_increment;
+    record->volume_scale = event->volume_scale;
+    record->instrument_id = (uint16_t)instrument_to_id(event->instrument);
+    record->pan = event->pan;
+
+    if (event->instrument && event->instrument->envelope == pluck_envelope) {
+        const pluck_decay_t* pluck = &event->envelope_state.pluck;
+        record->envelope_kind = SCORE_ENVELOPE_PLUCK;
+        record->envelope[0] = (uint32_t)pluck->initial_amplitude;
+        record->envelope[1] = (uint32_t)pluck->decay_multiplier;
+        record->envelope[2] = (uint32_t)pluck->current_level;
+        return;
+    }
+
+    const adsr_t* adsr = &event->envelope_state.adsr;
+    record->envelope_kind = SCORE_ENVELOPE_ADSR;
+    record->envelope[0] = adsr->attack_samples;
+    record->envelope[1] = adsr->decay_samples;
+    record->envelope[2] = (uint32_t)adsr->sustain_level;
+    record->envelope[3] = adsr->release_samples;
+    record->envelope[4] = (uint32_t)adsr->current_level;
+    record->envelope[5] = (uint32_t)adsr->release_start_level;
+    record->envelope[6] = (uint32_t)adsr->release_coeff;
+    record->envelope[7] = adsr->min_release_samples;
+    record->envelope[8] = adsr->phase;
+}
+
+void score_decode_event(const score_event_record_t* record, event_t* event) {
+    memset(event, 0, sizeof(*event));
+    event->start_sample = record->start_sample;
+    event->duration_samples = record->duration_samples;
+    event->release_sample = record->release_sample;
+    event->phase_increment = record->phase_increment;
+    event->volume_scale = record->volume_scale;
+    event->pan = record->pan;
+    event->instrument = instrument_from_id((instrument_id_t)record->instrument_id);
+    event->partials = instrument_partial_table(event->instrument);
+
+    if (record->envelope_kind == SCORE_ENVELOPE_PLUCK) {
+        pluck_decay_t* pluck = &event->envelope_state.pluck;
+        pluck->initial_amplitude = (int32_t)record->envelope[0];
+        pluck->decay_multiplier = (int32_t)record->envelope[1];
+        pluck->current_level = (int32_t)record->envelope[2];
+        return;
+    }
+
+    adsr_t* adsr = &event->envelope_state.adsr;
+    adsr->attack_samples = record->envelope[0];
+    adsr->decay_samples = record->envelope[1];
+    int32_t sustain_level = (int32_t)record->envelope[2];
+    adsr->sustain_level = sustain_level < 0 ? 0 : sustain_level; // The envelopes assume [0, full scale]
+    adsr->release_samples = record->envelope[3];
+    adsr->current_level = (int32_t)record->envelope[4];
+    adsr->release_start_level = (int32_t)record->envelope[5];
+    adsr->release_coeff = (int32_t)record->envelope[6];
+    adsr->min_release_samples = record->envelope[7];
+    adsr->phase = (uint8_t)record->envelope[8];
+}
+
+// ============================================================================
+// WRITING
+// ============================================================================
+
+bool score_file_write(const char* path, const event_array_t* events, uint32_t sample_rate) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    score_file_header_t header = {0};
+    memcpy(header.magic, SCORE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCORE_FILE_VERSION;
+    header.header_size = sizeof(score_file_header_t);
+    header.byte_order = SCORE_FILE_BYTE_ORDER;
+    header.sample_rate = sample_rate;
+    header.num_events = (uint32_t)events->count;
+    header.record_size = sizeof(score_event_record_t);
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < events->count; i++) {
+        score_event_record_t record;
+        encode_event(&events->data[i], &record);
+        ok = fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+// ============================================================================
+// LOADING
+// ============================================================================
+
+bool score_file_from_memory(score_file_t* score, const void* data, size_t size) {
+    memset(score, 0, sizeof(*score));
+    if (!data || size < sizeof(score_file_header_t)) {
+        return false;
+    }
+
+    const score_file_header_t* header = data;
+    if (memcmp(header->magic, SCORE_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SCORE_FILE_VERSION || header->byte_order != SCORE_FILE_BYTE_ORDER ||
+        header->header_size != sizeof(score_file_header_t) || header->record_size != sizeof(score_event_record_t) ||
+        header->sample_rate == 0) {
+        return false;
+    }
+    if ((size - header->header_size) / header->record_size < header->num_events) {
+        return false; // Truncated
+    }
+
+    const score_event_record_t* records =
+        (const score_event_record_t*)((const unsigned char*)data + header->header_size);
+
+    // Reject anything the decoder would not map back to a real instrument or envelope
+    for (uint32_t i = 0; i < header->num_events; i++) {
+        const score_event_record_t* record = &records[i];
+        if (record->envelope_kind > SCORE_ENVELOPE_PLUCK ||
+            (record->instrument_id >= NUM_INSTRUMENT_IDS && record->instrument_id != INSTRUMENT_ID_NONE)) {
+            return false;
+        }
+        if (i > 0 && record->start_sample < records[i - 1].start_sample) {
+            return false; // The sequencer needs chronological order
+        }
+    }
+
+    score->header = header;
+    score->records = records;
+    return true;
+}
+
+bool score_file_open(score_file_t* score, const char* path) {
+    memset(score, 0, sizeof(*score));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file referenced
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    if (!score_file_from_memory(score, mapping, size)) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    score->mapping = mapping;
+    score->mapping_size = size;
+    return true;
+}
+
+void score_file_close(score_file_t* score) {
+    if (score->mapping) {
+        munmap(score->mapping, score->mapping_size);
+    }
+    memset(score, 0, sizeof(*score));
+}
+
+// ============================================================================
+// PLAYBACK
+// ============================================================================
+
+sequencer_state_t* create_mapped_sequencer(const score_file_t* score) {
+    sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
+    if (!seq) {
+        return NULL;
+    }
+
+    seq->stream = calloc(1, sizeof(event_stream_t));
+    if (!seq->stream) {
+        free(seq);
+        return NULL;
+    }
+
+    // Build the partial tables now rather than on the audio thread at the first note
+    instrument_init();
+
+    seq->stream->records = score->records;
+    seq->stream->num_records = score->header->num_events;
+    event_stream_fill(seq->stream);
+    seq->sample_rate = score->header->sample_rate;
+    return seq;
+}
@@ -0,0 +1,80 @@
+#ifndef SCORE_FILE_H
+#define SCORE_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sequencer.h"
+
+// ============================================================================
+// COMPILED SCORE FORMAT
+// ============================================================================
+
+// A compiled score is the output of sequence_events in fixed-point form: a header followed by
+// num_events fixed-size records, in the writer's byte order and naturally aligned so the records can
+// be read in place from an mmap'd file or from flash. Files from a host of the other byte order are
+// rejected (see SCORE_FILE_BYTE_ORDER); compile on a machine with the player's endianness.
+
+#define SCORE_FILE_MAGIC "MBSC"
+#define SCORE_FILE_VERSION 1
+#define SCORE_FILE_BYTE_ORDER 0x01020304u // Written in host order, rejected if it reads back swapped
+
+typedef struct {
+    char magic[4]; // SCORE_FILE_MAGIC
+    uint16_t version; // SCORE_FILE_VERSION
+    uint16_t header_size; // sizeof(score_file_header_t), records start here
+    uint32_t byte_order; // SCORE_FILE_BYTE_ORDER
+    uint32_t sample_rate; // Rate the event times and phase increments were computed for
+    uint32_t num_events;
+    uint32_t record_size; // sizeof(score_event_record_t)
+} score_file_header_t;
+
+typedef enum {
+    SCORE_ENVELOPE_ADSR = 0,
+    SCORE_ENVELOPE_PLUCK = 1,
+} score_envelope_kind_t;
+
+// event_t with the instrument as an ID; the partial table is looked up again on load
+typedef struct score_event_record {
+    uint32_t start_sample;
+    uint32_t duration_samples;
+    uint32_t release_sample;
+    uint32_t phase_increment;
+    int32_t volume_scale;
+    uint16_t instrument_id; // instrument_id_t
+    uint8_t envelope_kind; // score_envelope_kind_t
+    int8_t pan; // event_t.pan (0 in files written before panning existed)
+    uint32_t envelope[9]; // Envelope state fields in declaration order (see score_file.c)
+} score_event_record_t;
+
+// A validated compiled score, mapped from a file or wrapped around a memory blob
+typedef struct {
+    const score_file_header_t* header;
+    const score_event_record_t* records;
+    void* mapping; // mmap'd region to unmap, NULL for memory blobs
+    size_t mapping_size;
+} score_file_t;
+
+// ============================================================================
+// COMPILED SCORE FUNCTIONS
+// ============================================================================
+
+// Write events sequenced at sample_rate as a compiled score, returns false on I/O error
+bool score_file_write(const char* path, const event_array_t* events, uint32_t sample_rate);
+
+// Map and validate a compiled score file, returns false if it cannot be used
+bool score_file_open(score_file_t* score, const char* path);
+
+// Validate a compiled score already in memory (e.g. flash), which must outlive the score
+bool score_file_from_memory(score_file_t* score, const void* data, size_t size);
+
+void score_file_close(score_file_t* score);
+
+// Rebuild a playable event from a record (integer only, safe on the audio thread)
+void score_decode_event(const score_event_record_t* record, event_t* event);
+
+// Create a sequencer playing straight from the records (free with cleanup_sequencer_state
+// before closing the score)
+sequencer_state_t* create_mapped_sequencer(const score_file_t* score);
+
+#endif // SCORE_FILE_H
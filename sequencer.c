@@ -1,119 +1,237 @@
 #include "sequencer.h"
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "array.h"
+#include "oscillator.h"
+#include "rt_log.h"
+#include "rt_stats.h"
+#include "score_file.h"
 
 DEFINE_ARRAY_FUNCTIONS(event, event_t)
 
 // ============================================================================
-// GLOBAL SINE TABLE AND UTILITIES
+// INITIALIZATION
 // ============================================================================
 
-#define SINE_TABLE_SIZE 1024
-static int32_t sine_table[SINE_TABLE_SIZE];
+bool sequencer_verbose = true;
 
 void music_init(void) {
-    for (int i = 0; i < SINE_TABLE_SIZE; i++) {
-        double angle = 2.0 * M_PI * i / SINE_TABLE_SIZE;
-        sine_table[i] = (int32_t)(sin(angle) * 0x7FFFFFFF);
-    }
+    oscillator_init();
+    instrument_init();
 }
 
 // ============================================================================
 // EVENT AND SAMPLE GENERATION
 // ============================================================================
 
+#define NYQUIST_PHASE_INCREMENT 0x80000000u // Half a cycle per sample
+#define PLUCK_DECAY_SECONDS 1.5 // Time for a pluck to decay by 60dB
+
 // Convert frequency to phase increment (unsigned for DDS)
-static uint32_t freq_to_phase_increment(double freq, uint16_t sample_rate) {
+static uint32_t freq_to_phase_increment(double freq, uint32_t sample_rate) {
     return (uint32_t)((freq / sample_rate) * 0x100000000LL);
 }
 
+// ============================================================================
+// PHASE INCREMENT TABLES
+// ============================================================================
+
+#define MAX_PHASE_TABLES 8 // (temperament, sample rate) pairs cached
+
+static struct {
+    const temperament_t* temperament;
+    uint32_t sample_rate;
+    uint32_t table[PHASE_TABLE_SEMITONES];
+} phase_tables[MAX_PHASE_TABLES];
+static atomic_int num_phase_tables = 0; // Published with release once a table is complete
+static pthread_mutex_t phase_table_lock = PTHREAD_MUTEX_INITIALIZER; // Serializes builders, not lookups
+
+static void build_phase_table(const temperament_t* temperament, uint32_t sample_rate, uint32_t* table) {
+    for (int semitone = 0; semitone < PHASE_TABLE_SEMITONES; semitone++) {
+        double freq = temperament->compute_frequency(semitone);
+        table[semitone] = (freq > 0.0 && freq < sample_rate / 2.0) ? freq_to_phase_increment(freq, sample_rate) : 0;
+    }
+}
+
+const uint32_t* get_phase_increment_table(const temperament_t* temperament, uint32_t sample_rate) {
+    if (!temperament || !temperament->compute_frequency || sample_rate == 0) {
+        return NULL;
+    }
+
+    int count = atomic_load_explicit(&num_phase_tables, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (phase_tables[i].temperament == temperament && phase_tables[i].sample_rate == sample_rate) {
+            return phase_tables[i].table;
+        }
+    }
+
+    // Miss: build under the lock, after checking the tables another builder added meanwhile
+    pthread_mutex_lock(&phase_table_lock);
+    const uint32_t* table = NULL;
+    int built = atomic_load_explicit(&num_phase_tables, memory_order_relaxed);
+    for (int i = count; i < built; i++) {
+        if (phase_tables[i].temperament == temperament && phase_tables[i].sample_rate == sample_rate) {
+            table = phase_tables[i].table;
+        }
+    }
+    if (!table && built < MAX_PHASE_TABLES) {
+        phase_tables[built].temperament = temperament;
+        phase_tables[built].sample_rate = sample_rate;
+        build_phase_table(temperament, sample_rate, phase_tables[built].table);
+        atomic_store_explicit(&num_phase_tables, built + 1, memory_order_release);
+        table = phase_tables[built].table;
+    }
+    pthread_mutex_unlock(&phase_table_lock);
+    return table;
+}
+
+uint32_t note_phase_increment(const note_t* note, const temperament_t* temperament, const key_signature_t* key,
+                              int transposition, uint32_t sample_rate) {
+    int semitone = note_to_absolute_semitone(note, key, transposition);
+    if (semitone < 0) {
+        return 0; // Rest or invalid note
+    }
+
+    const uint32_t* table = get_phase_increment_table(temperament, sample_rate);
+    if (table && semitone < PHASE_TABLE_SEMITONES) {
+        return table[semitone];
+    }
+
+    // Outside the table (or cache full): compute directly
+    double freq = note_to_frequency(note, temperament, key, transposition);
+    return (freq > 0.0 && freq < sample_rate / 2.0) ? freq_to_phase_increment(freq, sample_rate) : 0;
+}
+
+// Initialize the envelope state for the event's instrument
+static void setup_envelope_state(event_t* event, uint32_t sample_rate) {
+    if (event->instrument && event->instrument->envelope == pluck_envelope) {
+        // Exponential decay from full scale to -60dB over PLUCK_DECAY_SECONDS
+        double multiplier = exp(log(0.001) / (sample_rate * PLUCK_DECAY_SECONDS));
+        event->envelope_state.pluck.initial_amplitude = 0x7FFFFFFF;
+        event->envelope_state.pluck.decay_multiplier = (int32_t)(multiplier * 0x7FFFFFFF);
+        event->envelope_state.pluck.current_level = 0x7FFFFFFF;
+        return;
+    }
+
+    // Setup ADSR envelope (keyboard-like with anti-click release)
+    event->envelope_state.adsr.attack_samples = (uint32_t)(sample_rate * 0.05f); // 50ms attack
+    event->envelope_state.adsr.decay_samples = (uint32_t)(sample_rate * 0.2f); // 200ms decay
+    event->envelope_state.adsr.sustain_level = (int32_t)(0.6f * 0x7FFFFFFF); // 60% sustain
+    event->envelope_state.adsr.release_samples = (uint32_t)(sample_rate * 0.5f); // 500ms release
+    event->envelope_state.adsr.min_release_samples = (uint32_t)(sample_rate * 0.02f); // 20ms minimum
+    event->envelope_state.adsr.current_level = AUDIBLE_THRESHOLD;
+    event->envelope_state.adsr.release_start_level = 0;
+    event->envelope_state.adsr.release_coeff = adsr_release_coeff(event->envelope_state.adsr.release_samples,
+                                                                  event->envelope_state.adsr.min_release_samples);
+    event->envelope_state.adsr.phase = ADSR_ATTACK;
+}
+
 // Helper function to check if two notes should be simultaneous (part of same chord)
 static bool notes_are_simultaneous(const note_t* note1, const note_t* note2) {
     return (note1->chord_id > 0 && note1->chord_id == note2->chord_id);
 }
 
-// Convert parsed notes to sequencer events with proper fixed-point arithmetic
-event_array_t sequence_events(const note_array_t* notes, uint16_t sample_rate, int tempo_bpm,
-                              const key_signature_t* key, const temperament_t* temperament, int transposition,
-                              float volume) {
-    event_array_t events = {0};
-    if (!notes || !notes->data || notes->count == 0) {
-        return events;
+// Samples per beat in Q48.16. Note times are kept in this fixed point and only rounded down to
+// whole samples per event, so tempos that do not divide the rate evenly never drift.
+static uint64_t beat_length_q16(uint32_t sample_rate, int tempo_bpm) {
+    return ((uint64_t)sample_rate * 60 << 16) / (uint64_t)tempo_bpm;
+}
+
+// Written duration of a note in Q48.16 samples
+static uint64_t note_duration_q16(const note_t* note, uint64_t beat_length) {
+    uint64_t duration = beat_length * 4 / (uint64_t)note->value;
+    if (note->dotted) {
+        duration = duration * 3 / 2;
     }
+    if (note->tuplet > 0) {
+        int numerator, denominator;
+        get_tuplet_fraction(note->tuplet, &numerator, &denominator);
+        duration = duration * (uint64_t)numerator / (uint64_t)denominator;
+    }
+    return duration;
+}
+
+// Build the event for a sounding note spanning [position, position + duration) in Q48.16 samples,
+// returns false for rests and unplayable pitches
+static bool note_to_event(const note_t* note, int chord_size, uint64_t position, uint64_t duration,
+                          uint32_t sample_rate, const key_signature_t* key, const temperament_t* temperament,
+                          int transposition, float volume, event_t* out) {
+    if (is_rest(note)) {
+        return false;
+    }
+
+    // Pitch from the shared per-temperament table (0 means no frequency or at/above Nyquist)
+    uint32_t phase_increment = note_phase_increment(note, temperament, key, transposition, sample_rate);
+    if (phase_increment == 0) {
+        return false;
+    }
+
+    event_t event = {0};
+
+    // Set up basic event parameters: both ends are rounded from the exact times, so the
+    // written lengths of consecutive notes add up to exactly their total
+    uint64_t start_sample = position >> 16;
+    uint32_t written_samples = (uint32_t)(((position + duration) >> 16) - start_sample);
+    event.start_sample = start_sample;
+    event.duration_samples = (uint32_t)(written_samples * 0.9); // 90% of written duration
+    event.release_sample = start_sample + event.duration_samples;
+    event.instrument = note->instrument;
+
+    // Partials are expanded from the instrument's precomputed table when the event is activated
+    event.partials = instrument_partial_table(note->instrument);
+    event.phase_increment = phase_increment;
+
+    // Volume scaling for chords
+    float event_volume = volume;
+    if (note->chord_id > 0) {
+        event_volume = volume / sqrtf((float)chord_size);
+    }
+    event.volume_scale = (int32_t)(event_volume * 0x10000000); // Convert to Q1.31
+
+    setup_envelope_state(&event, sample_rate);
 
+    *out = event;
+    return true;
+}
+
+// Sequence notes onto their tracks' timelines, appending track t's events to timelines[t]
+// (a single-track score needs only timelines[0]). Every timeline comes out sorted by start.
+// Returns false if an array could not grow.
+static bool sequence_timelines(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm,
+                               const key_signature_t* key, const temperament_t* temperament, int transposition,
+                               float volume, event_array_t* timelines) {
     // Calculate timing
-    int samples_per_beat = (60 * sample_rate) / tempo_bpm;
-    uint64_t current_sample = 0;
+    uint64_t beat_length = beat_length_q16(sample_rate, tempo_bpm);
+    uint64_t position[MAX_SCORE_TRACKS] = {0}; // Q48.16 samples, per track
 
-    // Calculate chord volume scaling
-    float base_volume = volume;
+    int chord_size = 1; // Size of the chord run the current note belongs to
 
     for (int i = 0; i < notes->count; i++) {
         const note_t* note = &notes->data[i];
+        int track = note->track < MAX_SCORE_TRACKS ? note->track : 0;
 
-        // Calculate duration in samples
-        int duration_samples = (samples_per_beat * 4) / note->value;
-        if (note->dotted) {
-            duration_samples = (duration_samples * 3) / 2;
-        }
-        if (note->tuplet > 0) {
-            float tuplet_ratio = get_tuplet_ratio(note->tuplet);
-            duration_samples = (int)((float)duration_samples * tuplet_ratio);
-        }
-
-        // Only create events for non-rests
-        if (!is_rest(note)) {
-            // Calculate frequency
-            double freq = note_to_frequency(note, temperament, key, transposition);
-
-            if (freq > 0.0) {
-                // Allocate event with one partial (can be extended for additive synthesis later)
-                event_t event = {0};
-
-                // Set up basic event parameters
-                event.start_sample = current_sample;
-                event.duration_samples = (uint32_t)(duration_samples * 0.9); // 90% of written duration
-                event.release_sample = current_sample + event.duration_samples;
-                event.num_partials = 1;
-                event.instrument = note->instrument;
-
-                // Volume scaling for chords
-                float event_volume = base_volume;
-                if (note->chord_id > 0) {
-                    // Count chord size for volume scaling
-                    int chord_size = 1;
-                    for (int j = 0; j < notes->count; j++) {
-                        if (j != i && notes->data[j].chord_id == note->chord_id) {
-                            chord_size++;
-                        }
-                    }
-                    event_volume = base_volume / sqrtf((float)chord_size);
-                }
-                event.volume_scale = (int32_t)(event_volume * 0x10000000); // Convert to Q1.31
-
-                // Setup single partial (fundamental frequency)
-                event.partials[0].phase_accum = 0;
-                event.partials[0].phase_increment = freq_to_phase_increment(freq, sample_rate);
-                event.partials[0].amplitude = 0x7FFFFFFF; // Full amplitude for this partial
-
-                // Setup ADSR envelope (keyboard-like with anti-click release)
-                event.envelope_state.adsr.attack_samples = (uint32_t)(sample_rate * 0.05f); // 50ms attack
-                event.envelope_state.adsr.decay_samples = (uint32_t)(sample_rate * 0.2f); // 200ms decay
-                event.envelope_state.adsr.sustain_level = (int32_t)(0.6f * 0x7FFFFFFF); // 60% sustain
-                event.envelope_state.adsr.release_samples = (uint32_t)(sample_rate * 0.5f); // 500ms release
-                event.envelope_state.adsr.min_release_samples = (uint32_t)(sample_rate * 0.02f); // 20ms minimum
-                event.envelope_state.adsr.current_level = AUDIBLE_THRESHOLD;
-                event.envelope_state.adsr.release_start_level = 0;
-                event.envelope_state.adsr.release_coeff = 0;
-                event.envelope_state.adsr.phase = ADSR_ATTACK;
-
-                // Add to events array (we'll need to implement this push function)
-                event_array_push(&events, event);
+        // Chord notes are consecutive: count the run once, at its first note
+        if (note->chord_id > 0 && (i == 0 || !notes_are_simultaneous(&notes->data[i - 1], note))) {
+            chord_size = 1;
+            while (i + chord_size < notes->count && notes_are_simultaneous(note, &notes->data[i + chord_size])) {
+                chord_size++;
             }
         }
 
+        uint64_t duration = note_duration_q16(note, beat_length);
+
+        event_t event;
+        if (note_to_event(note, chord_size, position[track], duration, sample_rate, key, temperament, transposition,
+                          volume, &event) &&
+            !event_array_push(&timelines[track], event)) {
+            return false;
+        }
+
         // Advance time logic - only if not part of a simultaneous chord
         bool advance_time = true;
         if (i + 1 < notes->count) {
@@ -123,138 +241,1177 @@ event_array_t sequence_events(const note_array_t* notes, uint16_t sample_rate, i
             advance_time = true;
         }
         if (advance_time) {
-            current_sample += duration_samples;
+            position[track] += duration;
         }
     }
+    return true;
+}
 
-    // Shrink array to fit for memory efficiency
-    event_array_shrink_to_fit(&events);
+// Notes per track, returns the number of tracks (the highest one used + 1)
+static int count_track_notes(const note_array_t* notes, int counts[MAX_SCORE_TRACKS]) {
+    int num_tracks = 0;
+    for (int t = 0; t < MAX_SCORE_TRACKS; t++) {
+        counts[t] = 0;
+    }
+    for (int i = 0; i < notes->count; i++) {
+        int track = notes->data[i].track < MAX_SCORE_TRACKS ? notes->data[i].track : 0;
+        counts[track]++;
+        if (track >= num_tracks) {
+            num_tracks = track + 1;
+        }
+    }
+    return num_tracks;
+}
 
-    printf("Converted %d notes to %d events\n", notes->count, events.count);
-    return events;
+// Convert parsed notes to sequencer events with proper fixed-point arithmetic
+event_array_t sequence_events(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm,
+                              const key_signature_t* key, const temperament_t* temperament, int transposition,
+                              float volume) {
+    return sequence_events_arena(notes, sample_rate, tempo_bpm, key, temperament, transposition, volume, NULL);
 }
 
-int16_t generate_event_sample(event_t* event, uint32_t current_sample_index) {
-    uint32_t samples_since_start = current_sample_index - event->start_sample;
-    uint32_t samples_until_release = event->release_sample - current_sample_index;
+event_array_t sequence_events_arena(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm,
+                                    const key_signature_t* key, const temperament_t* temperament, int transposition,
+                                    float volume, arena_t* arena) {
+    event_array_t events;
+    event_array_init_arena(&events, arena);
+    if (!notes || !notes->data || notes->count == 0) {
+        return events;
+    }
+
+    int counts[MAX_SCORE_TRACKS];
+    int num_tracks = count_track_notes(notes, counts);
+    if (num_tracks == 1) {
+        // At most one event per note, so the array never has to grow
+        if (!event_array_reserve(&events, notes->count) ||
+            !sequence_timelines(notes, sample_rate, tempo_bpm, key, temperament, transposition, volume, &events)) {
+            printf("Out of memory sequencing %d notes\n", notes->count);
+            event_array_free(&events);
+            return events;
+        }
 
-    // Get envelope level using the instrument's envelope function
-    int32_t envelope_level;
-    if (event->instrument && event->instrument->envelope) {
-        envelope_level =
-            event->instrument->envelope(&event->envelope_state, samples_since_start, samples_until_release);
+        // Shrink array to fit for memory efficiency
+        event_array_shrink_to_fit(&events);
     } else {
-        // Fallback to full volume if no envelope function
-        envelope_level = 0x7FFFFFFF;
+        // Each track is already in order, so merging them beats sorting the whole score
+        event_array_t tracks[MAX_SCORE_TRACKS];
+        if (sequence_tracks(notes, sample_rate, tempo_bpm, key, temperament, transposition, volume, tracks) == 0) {
+            return events; // Out of memory, already reported
+        }
+        if (!merge_event_arrays_arena(tracks, num_tracks, arena, &events)) {
+            printf("Out of memory merging %d score tracks\n", num_tracks);
+            event_array_free(&events);
+        }
+        for (int t = 0; t < num_tracks; t++) {
+            event_array_free(&tracks[t]);
+        }
+    }
+
+    if (sequencer_verbose) {
+        printf("Converted %d notes to %d events\n", notes->count, events.count);
+    }
+    return events;
+}
+
+int sequence_tracks(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm, const key_signature_t* key,
+                    const temperament_t* temperament, int transposition, float volume,
+                    event_array_t tracks[MAX_SCORE_TRACKS]) {
+    if (!notes || !notes->data || notes->count == 0) {
+        return 0;
+    }
+
+    int counts[MAX_SCORE_TRACKS];
+    int num_tracks = count_track_notes(notes, counts);
+    bool reserved = true;
+    for (int t = 0; t < num_tracks; t++) {
+        event_array_init(&tracks[t]);
+        reserved &= event_array_reserve(&tracks[t], counts[t]) != 0;
+    }
+
+    if (!reserved ||
+        !sequence_timelines(notes, sample_rate, tempo_bpm, key, temperament, transposition, volume, tracks)) {
+        printf("Out of memory sequencing %d notes on %d tracks\n", notes->count, num_tracks);
+        for (int t = 0; t < num_tracks; t++) {
+            event_array_free(&tracks[t]);
+        }
+        return 0;
+    }
+    for (int t = 0; t < num_tracks; t++) {
+        event_array_shrink_to_fit(&tracks[t]);
+    }
+    return num_tracks;
+}
+
+// ============================================================================
+// K-WAY MERGE
+// ============================================================================
+
+// Heap entry: next event start << 32 | array index, so one compare orders by start and breaks
+// ties by the lower array (a stable merge), and sifting never touches the events themselves
+static inline uint64_t merge_key(uint32_t start, int array) { return (uint64_t)start << 32 | (uint32_t)array; }
+
+static void merge_sift_down(uint64_t* heap, int size, int i) {
+    uint64_t item = heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap[child + 1] < heap[child]) {
+            child++;
+        }
+        if (heap[child] >= item) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+bool merge_event_arrays(const event_array_t* arrays, int count, event_array_t* merged) {
+    return merge_event_arrays_arena(arrays, count, NULL, merged);
+}
+
+bool merge_event_arrays_arena(const event_array_t* arrays, int count, arena_t* arena, event_array_t* merged) {
+    event_array_init_arena(merged, arena);
+    if (!arrays || count <= 0) {
+        return true;
+    }
+
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        if (arrays[i].count > INT_MAX - total) {
+            return false;
+        }
+        total += arrays[i].count;
+    }
+    if (total == 0) {
+        return true;
+    }
+    uint64_t* heap = malloc((size_t)count * sizeof(uint64_t));
+    int* next = malloc((size_t)count * sizeof(int)); // Next unmerged event of each array
+    if (!heap || !next || !event_array_reserve(merged, total)) {
+        free(heap);
+        free(next);
+        return false;
+    }
+
+    // Min-heap of the arrays that still have events
+    int size = 0;
+    for (int i = 0; i < count; i++) {
+        next[i] = 0;
+        if (arrays[i].count > 0) {
+            heap[size++] = merge_key(arrays[i].data[0].start_sample, i);
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; i--) {
+        merge_sift_down(heap, size, i);
+    }
+
+    // O(n log k): take the earliest event, then re-key its array by the one after it
+    while (size > 0) {
+        int array = (int)(uint32_t)heap[0];
+        const event_array_t* top = &arrays[array];
+        int index = next[array]++;
+        merged->data[merged->count++] = top->data[index];
+        if (index + 1 < top->count) {
+            heap[0] = merge_key(top->data[index + 1].start_sample, array);
+        } else {
+            heap[0] = heap[--size];
+        }
+        merge_sift_down(heap, size, 0);
+    }
+
+    free(heap);
+    free(next);
+    return true;
+}
+
+// ============================================================================
+// EVENT STREAM
+// ============================================================================
+
+void event_stream_init(event_stream_t* stream, const char* score, uint32_t sample_rate, int tempo_bpm,
+                       const key_signature_t* key, const temperament_t* temperament, int transposition,
+                       float volume) {
+    memset(stream, 0, sizeof(*stream));
+    parse_cursor_init(&stream->cursor, score);
+    stream->score = score;
+    stream->sample_rate = sample_rate;
+    stream->beat_length = beat_length_q16(sample_rate, tempo_bpm);
+    stream->key = key;
+    stream->temperament = temperament;
+    stream->transposition = transposition;
+    stream->volume = volume;
+    get_phase_increment_table(temperament, sample_rate); // Build now, not during a refill on the audio thread
+}
+
+// Parse and sequence notes (or decode records) until the ring is full or the score ends.
+// When parsing, a whole chord must fit, so up to MAX_CHORD_SIZE - 1 slots can stay free.
+int event_stream_fill(event_stream_t* stream) {
+    int added = 0;
+    note_t notes[MAX_CHORD_SIZE];
+
+    if (stream->records) {
+        while (stream->head - stream->tail < EVENT_STREAM_CAPACITY && stream->next_record < stream->num_records) {
+            score_decode_event(&stream->records[stream->next_record++],
+                               &stream->ring[stream->head++ % EVENT_STREAM_CAPACITY]);
+            added++;
+        }
+        return added;
     }
 
-    // Generate samples from all partials
-    int32_t event_sample = 0;
-    for (int i = 0; i < event->num_partials; i++) {
-        partial_t* p = &event->partials[i];
+    while (EVENT_STREAM_CAPACITY - (stream->head - stream->tail) >= MAX_CHORD_SIZE) {
+        int count = parse_cursor_next(&stream->cursor, notes);
+        if (count == 0) {
+            break; // Score exhausted
+        }
 
-        // Get sine wave sample using proper DDS lookup
-        uint32_t table_index = (p->phase_accum >> 22) & (SINE_TABLE_SIZE - 1);
-        int32_t wave_sample = sine_table[table_index];
+        // A chord comes out of the cursor whole, so its size is simply the note count
+        for (int i = 0; i < count; i++) {
+            const note_t* note = &notes[i];
+            uint64_t duration = note_duration_q16(note, stream->beat_length);
 
-        // Apply partial amplitude (Q1.31 * Q1.31 = Q2.62, shift back to Q1.31)
-        int64_t partial_sample = (int64_t)wave_sample * p->amplitude;
-        event_sample += (int32_t)(partial_sample >> 31);
+            event_t* event = &stream->ring[stream->head % EVENT_STREAM_CAPACITY];
+            if (note_to_event(note, count, stream->current_position, duration, stream->sample_rate, stream->key,
+                              stream->temperament, stream->transposition, stream->volume, event)) {
+                stream->head++;
+                added++;
+            }
 
-        // Advance phase (unsigned arithmetic wraps properly)
-        p->phase_accum += p->phase_increment;
+            // Same rule as sequence_events: time advances after the chord and on every rest
+            if (i == count - 1 || is_rest(note)) {
+                stream->current_position += duration;
+            }
+        }
     }
 
-    // Apply envelope (Q1.31 * Q1.31 = Q2.62, shift back to Q1.31)
-    int64_t enveloped_sample = (int64_t)event_sample * envelope_level;
-    enveloped_sample >>= 31;
+    return added;
+}
 
-    // Apply volume scaling (Q1.31 * Q1.31 = Q2.62, shift back to Q1.31)
-    int64_t final_sample = enveloped_sample * event->volume_scale;
-    final_sample >>= 31;
+// Restart a stream from the beginning of its score (text or records)
+static void event_stream_rewind(event_stream_t* stream) {
+    stream->head = 0;
+    stream->tail = 0;
+    stream->next_record = 0;
+    stream->current_position = 0;
+    if (stream->score) {
+        parse_cursor_init(&stream->cursor, stream->score);
+    }
+}
 
-    // Convert Q1.31 to S16 (shift by 16 more bits)
-    return (int16_t)(final_sample >> 16);
+// Whether a score switches to a named {track} ("{}" is the default track, so it does not count)
+static bool score_has_tracks(const char* score) {
+    for (const char* p = strchr(score, '{'); p; p = strchr(p + 1, '{')) {
+        if (p[1] != '}') {
+            return true;
+        }
+    }
+    return false;
 }
 
-int32_t get_current_envelope_level(event_t* event) {
-    // Return the current envelope level based on envelope type
-    // We can determine type by checking which envelope function is assigned
+sequencer_state_t* create_streaming_sequencer(const char* score, uint32_t sample_rate, int tempo_bpm,
+                                              const key_signature_t* key, const temperament_t* temperament,
+                                              int transposition, float volume) {
+    // A stream has one timeline: tracks would be played one after another instead of together
+    if (score && score_has_tracks(score)) {
+        printf("Cannot stream a score with {name} tracks, sequence it instead\n");
+        return NULL;
+    }
+
+    sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
+    if (!seq) {
+        return NULL;
+    }
+
+    seq->stream = malloc(sizeof(event_stream_t));
+    if (!seq->stream) {
+        free(seq);
+        return NULL;
+    }
+
+    event_stream_init(seq->stream, score, sample_rate, tempo_bpm, key, temperament, transposition,
+                      volume);
+    event_stream_fill(seq->stream); // First window, so the first quantum parses nothing
+    seq->sample_rate = sample_rate;
+    return seq;
+}
+
+// Next event not yet activated, refilling a streaming score's ring when it runs dry
+static const event_t* peek_next_event(sequencer_state_t* seq) {
+    event_stream_t* stream = seq->stream;
+
+    if (!stream) {
+        return seq->next_event_index < seq->events.count ? &seq->events.data[seq->next_event_index] : NULL;
+    }
+
+    if (stream->head == stream->tail && event_stream_fill(stream) == 0) {
+        return NULL;
+    }
+    return &stream->ring[stream->tail % EVENT_STREAM_CAPACITY];
+}
+
+// Consume the event returned by peek_next_event
+static void advance_next_event(sequencer_state_t* seq) {
+    if (seq->stream) {
+        seq->stream->tail++;
+    }
+    seq->next_event_index++;
+}
+
+// ============================================================================
+// VOICE POOL
+// ============================================================================
+
+// Copy an event into a free voice, expanding its partials and dropping those at or above Nyquist.
+// The voice plays at `pitch` (the event's, possibly transposed) over [start, release) in output samples.
+static void voice_pool_activate(voice_pool_t* pool, const event_t* event, int event_index, uint32_t pitch,
+                                uint32_t start, uint32_t release, uint32_t live_id) {
+    int v = pool->num_active++;
+    int base = v * MAX_PARTIALS;
+
+    uint8_t count = 0;
+    for (int i = 0; i < event->partials->num_partials; i++) {
+        uint64_t increment = ((uint64_t)pitch * event->partials->ratio_q16[i]) >> 16;
+        if (increment >= NYQUIST_PHASE_INCREMENT) {
+            continue; // Would alias
+        }
+
+        pool->phase_accum[base + count] = 0;
+        pool->phase_increment[base + count] = (uint32_t)increment;
+        pool->amplitude[base + count] = event->partials->amplitude[i];
+        count++;
+    }
+    pool->num_partials[v] = count;
+
+    // Wavetable instruments pick the mipmap level for this pitch once, at activation
+    pool->wavetable[v] = NULL;
+    if (event->instrument && event->instrument->waveform != WAVEFORM_NONE && count > 0) {
+        pool->wavetable[v] = wavetable_for_increment(event->instrument->waveform, pool->phase_increment[base]);
+        pool->num_partials[v] = 1;
+    } else {
+        // Loudest first, so adaptive quality culls a suffix (the partials are summed, so the
+        // order does not change the output)
+        for (int i = 1; i < count; i++) {
+            uint32_t increment = pool->phase_increment[base + i];
+            int32_t amplitude = pool->amplitude[base + i];
+            int j = i;
+            for (; j > 0 && llabs(pool->amplitude[base + j - 1]) < llabs(amplitude); j--) {
+                pool->phase_increment[base + j] = pool->phase_increment[base + j - 1];
+                pool->amplitude[base + j] = pool->amplitude[base + j - 1];
+            }
+            pool->phase_increment[base + j] = increment;
+            pool->amplitude[base + j] = amplitude;
+        }
+    }
+    pool->rendered_partials[v] = pool->num_partials[v];
+
+    pool->envelope[v] = event->envelope_state;
+    pool->instrument[v] = event->instrument;
+    pool->start_sample[v] = start;
+    pool->release_sample[v] = release;
+    pool->pitch[v] = pitch;
+    pool->volume_scale[v] = event->volume_scale;
+    pool->event_index[v] = event_index;
+    pool->live_id[v] = live_id;
+
+    // Balance law: centre keeps both sides at unity, panning attenuates the opposite side only
+    int pan = event->pan < -127 ? -127 : event->pan;
+    pool->pan_left[v] = pan > 0 ? (uint32_t)(((uint64_t)(127 - pan) << 31) / 127) : PAN_UNITY_GAIN;
+    pool->pan_right[v] = pan < 0 ? (uint32_t)(((uint64_t)(127 + pan) << 31) / 127) : PAN_UNITY_GAIN;
+    pool->envelope_level[v] = 0x7FFFFFFF;
+    pool->fading[v] = false;
+    pool->fade_remaining[v] = 0;
+
     if (event->instrument && event->instrument->envelope == adsr_envelope) {
-        return event->envelope_state.adsr.current_level;
+        pool->envelope_level[v] = event->envelope_state.adsr.current_level;
     } else if (event->instrument && event->instrument->envelope == pluck_envelope) {
-        return event->envelope_state.pluck.current_level;
+        pool->envelope_level[v] = event->envelope_state.pluck.current_level;
+    }
+}
+
+// Free a voice by moving the last active voice into its slot
+static void voice_pool_remove(voice_pool_t* pool, int v) {
+    if (pool->fading[v]) {
+        pool->num_fading--;
+    }
+
+    int last = --pool->num_active;
+    if (v == last) {
+        return;
+    }
+
+    memcpy(&pool->phase_accum[v * MAX_PARTIALS], &pool->phase_accum[last * MAX_PARTIALS],
+           MAX_PARTIALS * sizeof(uint32_t));
+    memcpy(&pool->phase_increment[v * MAX_PARTIALS], &pool->phase_increment[last * MAX_PARTIALS],
+           MAX_PARTIALS * sizeof(uint32_t));
+    memcpy(&pool->amplitude[v * MAX_PARTIALS], &pool->amplitude[last * MAX_PARTIALS], MAX_PARTIALS * sizeof(int32_t));
+    pool->num_partials[v] = pool->num_partials[last];
+    pool->rendered_partials[v] = pool->rendered_partials[last];
+    pool->wavetable[v] = pool->wavetable[last];
+    pool->envelope[v] = pool->envelope[last];
+    pool->envelope_level[v] = pool->envelope_level[last];
+    pool->fading[v] = pool->fading[last];
+    pool->fade_remaining[v] = pool->fade_remaining[last];
+    pool->instrument[v] = pool->instrument[last];
+    pool->start_sample[v] = pool->start_sample[last];
+    pool->release_sample[v] = pool->release_sample[last];
+    pool->pitch[v] = pool->pitch[last];
+    pool->volume_scale[v] = pool->volume_scale[last];
+    pool->live_id[v] = pool->live_id[last];
+    pool->pan_left[v] = pool->pan_left[last];
+    pool->pan_right[v] = pool->pan_right[last];
+    pool->event_index[v] = pool->event_index[last];
+}
+
+// Render one voice over a contiguous span of samples, adding its S16-scaled output into the mix
+// planes (panned when there are two) with a Q16.16 master gain. The span must not cross a release
+// boundary of this voice (see next_block_boundary).
+static void render_voice_block(voice_pool_t* pool, int v, int32_t* mix, size_t stride, int planes,
+                               uint32_t master_volume, size_t num_samples, uint32_t start_index) {
+    int32_t osc[RENDER_BLOCK_SIZE] = {0};
+    int base = v * MAX_PARTIALS;
+    const int partials = pool->rendered_partials[v];
+
+    // 1. Oscillator bank: sum the rendered partials (or read the wavetable) for the whole span (Q1.31)
+    if (pool->wavetable[v] && partials > 0) {
+        render_wavetable(pool->wavetable[v], &pool->phase_accum[base], pool->phase_increment[base],
+                         pool->amplitude[base], osc, num_samples);
+    } else if (!pool->wavetable[v]) {
+        render_partials(&pool->phase_accum[base], &pool->phase_increment[base], &pool->amplitude[base], partials,
+                        osc, num_samples);
+    }
+
+    // 2. Envelope for the whole span, then envelope and volume mixed into the output span
+    int32_t levels[RENDER_BLOCK_SIZE];
+    const uint32_t start_sample = pool->start_sample[v];
+    const int32_t envelope_level =
+        envelope_render_block(pool->instrument[v], &pool->envelope[v], start_index - start_sample,
+                              (int32_t)(pool->release_sample[v] - start_index), levels, num_samples);
+    int32_t volume_scale = pool->volume_scale[v];
+    if (master_volume != Q16_ONE) {
+        int64_t scaled = ((int64_t)volume_scale * master_volume) >> 16;
+        volume_scale = scaled > INT32_MAX ? INT32_MAX : (int32_t)scaled;
+    }
+    const bool fade = pool->fading[v];
+    uint32_t fade_remaining = pool->fade_remaining[v];
+    const int64_t pan_left = pool->pan_left[v];
+    const int64_t pan_right = pool->pan_right[v];
+
+    if (partials == 0) {
+        // Silent (culled, or every partial above Nyquist): only the envelope and fade move on
+        pool->envelope_level[v] = envelope_level;
+        if (fade) {
+            pool->fade_remaining[v] = fade_remaining > num_samples ? fade_remaining - (uint32_t)num_samples : 0;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < num_samples; i++) {
+        // Apply envelope (Q1.31 * Q1.31 = Q2.62, shift back to Q1.31)
+        int64_t enveloped_sample = ((int64_t)osc[i] * levels[i]) >> 31;
+
+        // Apply volume scaling (Q1.31 * Q1.31 = Q2.62, shift back to Q1.31)
+        int64_t final_sample = (enveloped_sample * volume_scale) >> 31;
+
+        // Linear fade-out of a stolen voice
+        if (fade) {
+            int32_t fade_gain = (int32_t)(fade_remaining * (0x7FFFFFFF / STEAL_FADE_SAMPLES));
+            final_sample = (final_sample * fade_gain) >> 31;
+            if (fade_remaining > 0) {
+                fade_remaining--;
+            }
+        }
+
+        // Convert Q1.31 to S16 (shift by 16 more bits), after the pan gain for stereo
+        if (planes == 1) {
+            mix[i] += (int16_t)(final_sample >> 16);
+        } else {
+            mix[i] += (int16_t)((final_sample * pan_left) >> 47);
+            mix[stride + i] += (int16_t)((final_sample * pan_right) >> 47);
+        }
+    }
+
+    pool->envelope_level[v] = envelope_level;
+    pool->fade_remaining[v] = fade_remaining;
+}
+
+int32_t get_current_envelope_level(const voice_pool_t* pool, int voice) { return pool->envelope_level[voice]; }
+
+// ============================================================================
+// ADAPTIVE QUALITY
+// ============================================================================
+
+#define CULL_LEVEL_STEP_BITS 2 // The cull level quadruples per quantum over budget, halves per one well under
+
+// Live master gain (Q16.16) applied to every voice
+static inline uint32_t master_gain(const sequencer_state_t* seq) {
+    return seq->volume_set ? seq->master_volume : Q16_ONE;
+}
+
+// Q1.31 peak output of a voice's unit-amplitude oscillator: envelope times volume times the master
+// gain, saturated at full scale. A voice still in its attack is judged by the peak it is rising to.
+static int32_t voice_output_level(const sequencer_state_t* seq, int v) {
+    const voice_pool_t* pool = &seq->voices;
+    int32_t envelope = pool->envelope_level[v];
+    if (pool->instrument[v] && pool->instrument[v]->envelope == adsr_envelope &&
+        pool->envelope[v].adsr.phase == ADSR_ATTACK) {
+        envelope = 0x7FFFFFFF;
+    }
+    int64_t level = ((((int64_t)envelope * pool->volume_scale[v]) >> 31) * master_gain(seq)) >> 16;
+    return level < 0x7FFFFFFF ? (int32_t)level : 0x7FFFFFFF;
+}
+
+// Render only the leading (loudest) partials of each voice whose output reaches the cull level.
+// Restored partials get their phase back exactly: oscillators are memoryless, so a partial's
+// phase is its increment times the samples since the voice started.
+static void cull_partials(sequencer_state_t* seq) {
+    voice_pool_t* pool = &seq->voices;
+    const int32_t cull_level = seq->cull_level;
+    const uint32_t now = (uint32_t)seq->current_sample_index;
+
+    for (int v = 0; v < pool->num_active; v++) {
+        int base = v * MAX_PARTIALS;
+        int count = pool->num_partials[v];
+        if (cull_level > 0) {
+            int64_t level = voice_output_level(seq, v);
+            while (count > 0 && ((llabs(pool->amplitude[base + count - 1]) * level) >> 31) < cull_level) {
+                count--;
+            }
+        }
+
+        for (int p = pool->rendered_partials[v]; p < count; p++) {
+            pool->phase_accum[base + p] = pool->phase_increment[base + p] * (now - pool->start_sample[v]);
+        }
+        pool->rendered_partials[v] = (uint8_t)count;
+    }
+}
+
+// Once per callback: follow the render load (jumping to peaks, decaying by 1/8 per quantum) and
+// raise the cull level while it exceeds the budget, lowering it once under 3/4 of the budget
+static void adapt_quality(sequencer_state_t* seq, uint64_t render_ns, size_t num_frames) {
+    uint64_t period_ns = (uint64_t)num_frames * 1000000000ull / seq->sample_rate;
+    if (period_ns == 0) {
+        return;
+    }
+    uint64_t load = (render_ns << 16) / period_ns;
+    uint32_t current = load < UINT32_MAX ? (uint32_t)load : UINT32_MAX;
+    if (current >= seq->render_load) {
+        seq->render_load = current;
     } else {
-        // Unknown or no envelope, assume audible
-        return 0x7FFFFFFF;
+        seq->render_load -= (seq->render_load - current) >> 3;
+    }
+
+    if (seq->render_load > seq->cpu_budget) {
+        int32_t raised = seq->cull_level ? seq->cull_level << CULL_LEVEL_STEP_BITS : AUDIBLE_THRESHOLD;
+        seq->cull_level = raised < CULL_LEVEL_MAX ? raised : CULL_LEVEL_MAX;
+    } else if (seq->render_load < seq->cpu_budget - seq->cpu_budget / 4) {
+        seq->cull_level = seq->cull_level > AUDIBLE_THRESHOLD ? seq->cull_level >> 1 : 0;
     }
+
+    if (seq->cull_level) {
+        RT_STATS_CULLED();
+    }
+}
+
+void sequencer_set_cpu_budget(sequencer_state_t* seq, float share) {
+    seq->cpu_budget = share > 0.0f ? (uint32_t)(share * Q16_ONE + 0.5f) : 0;
+    seq->render_load = 0;
+    seq->cull_level = 0;
 }
 
 // ============================================================================
 // SEQUENCER CALLBACK
 // ============================================================================
 
-bool sequencer_callback(int16_t* buffer, size_t num_samples, void* user_data) {
-    sequencer_state_t* seq = (sequencer_state_t*)user_data;
+// Pick a sounding voice to make room for a note at `pitch` according to the steal policy, -1 if none
+static int choose_voice_to_steal(const sequencer_state_t* seq, uint32_t pitch) {
+    const voice_pool_t* pool = &seq->voices;
+    int victim = -1;
 
-    for (size_t i = 0; i < num_samples; i++) {
-        // 1. Activate new events that should start now
-        while (seq->next_event_index < seq->events.count &&
-               seq->events.data[seq->next_event_index].start_sample <= seq->current_sample_index) {
-
-            if (seq->num_active < MAX_SIMULTANEOUS_EVENTS) {
-                seq->active_events[seq->num_active] = &seq->events.data[seq->next_event_index];
-                seq->num_active++;
-                printf("Activated event %d at sample %lu\n", seq->next_event_index, seq->current_sample_index);
+    if (seq->steal_policy == VOICE_STEAL_NONE) {
+        return -1;
+    }
+
+    if (seq->steal_policy == VOICE_STEAL_SAME_PITCH) {
+        for (int v = 0; v < pool->num_active; v++) {
+            if (!pool->fading[v] && pool->pitch[v] == pitch) {
+                return v;
             }
-            seq->next_event_index++;
         }
+        // No voice at this pitch: fall back to the quietest
+    }
 
-        // 2. Generate sample from all active events (this updates envelopes)
-        int32_t mixed_sample = 0;
-        for (int j = 0; j < seq->num_active; j++) {
-            mixed_sample += generate_event_sample(seq->active_events[j], seq->current_sample_index);
+    for (int v = 0; v < pool->num_active; v++) {
+        if (pool->fading[v]) {
+            continue;
         }
+        if (victim < 0) {
+            victim = v;
+        } else if (seq->steal_policy == VOICE_STEAL_OLDEST) {
+            if (pool->start_sample[v] < pool->start_sample[victim]) {
+                victim = v;
+            }
+        } else if (get_current_envelope_level(pool, v) < get_current_envelope_level(pool, victim)) {
+            victim = v;
+        }
+    }
 
-        buffer[i] = (int16_t)mixed_sample;
+    return victim;
+}
 
-        // 3. Remove events that have completed their release phase (backwards iteration for safe removal)
-        for (int j = seq->num_active - 1; j >= 0; j--) {
-            event_t* event = seq->active_events[j];
+// Start a short fade-out on a voice so a new event can take its place in the polyphony budget
+static bool steal_voice(sequencer_state_t* seq, uint32_t pitch) {
+    voice_pool_t* pool = &seq->voices;
 
-            if (event->instrument && event->instrument->envelope == adsr_envelope) {
-                adsr_t* adsr = &event->envelope_state.adsr;
+    if (pool->num_fading >= MAX_FADING_VOICES) {
+        return false; // No slot left to fade out in
+    }
+
+    int victim = choose_voice_to_steal(seq, pitch);
+    if (victim < 0) {
+        return false;
+    }
 
-                // For ADSR: remove when in release phase and envelope has decayed to near zero
-                int32_t samples_until_release = event->release_sample - seq->current_sample_index;
+    pool->fading[victim] = true;
+    pool->fade_remaining[victim] = STEAL_FADE_SAMPLES;
+    pool->num_fading++;
+    seq->voices_stolen++;
+    RT_LOG(RT_LOG_EVENT_STOLEN, pool->event_index[victim], seq->current_sample_index);
+    return true;
+}
+
+// Score samples per output sample as Q16.16
+static inline uint32_t tempo_scale(const sequencer_state_t* seq) { return seq->tempo_scale ? seq->tempo_scale : Q16_ONE; }
 
-                if (samples_until_release <= 0 && adsr->current_level == 0) {
-                    // Release phase and exponential decay has reached zero
-                    printf("Removing completed ADSR event at sample %lu\n", seq->current_sample_index);
-                    seq->active_events[j] = seq->active_events[seq->num_active - 1];
-                    seq->num_active--;
-                }
-            } else {
-                // For other envelope types, use the threshold method
-                if (get_current_envelope_level(event) < AUDIBLE_THRESHOLD) {
-                    printf("Removing inaudible event at sample %lu\n", seq->current_sample_index);
-                    seq->active_events[j] = seq->active_events[seq->num_active - 1];
-                    seq->num_active--;
-                }
+// Output samples needed to cover `score_samples` (Q48.16) at the current tempo, rounded up
+static uint64_t score_to_output_samples(const sequencer_state_t* seq, uint64_t score_samples) {
+    uint32_t scale = tempo_scale(seq);
+    return (score_samples + scale - 1) / scale;
+}
+
+// Event duration (start to release) in output samples at the current tempo
+static uint32_t output_duration(const sequencer_state_t* seq, const event_t* event) {
+    uint64_t duration = (uint64_t)(event->release_sample - event->start_sample) << 16;
+    uint64_t output_length = score_to_output_samples(seq, duration);
+    return output_length < LIVE_NOTE_SUSTAIN ? (uint32_t)output_length : LIVE_NOTE_SUSTAIN;
+}
+
+// Give `event` a voice now (stealing if the polyphony limit is reached), false if it had to be dropped.
+// A voice resumed by a seek has already played `elapsed` output samples; its envelope state must
+// have been fast-forwarded to match.
+static bool activate_event(sequencer_state_t* seq, const event_t* event, int event_index, uint32_t live_id,
+                           uint32_t elapsed) {
+    voice_pool_t* pool = &seq->voices;
+    int max_voices = seq->max_voices;
+    if (max_voices <= 0 || max_voices > MAX_SIMULTANEOUS_EVENTS) {
+        max_voices = MAX_SIMULTANEOUS_EVENTS;
+    }
+
+    uint32_t pitch = event->phase_increment;
+    if (seq->pitch_ratio) {
+        uint64_t transposed = ((uint64_t)pitch * seq->pitch_ratio) >> 16;
+        pitch = transposed < NYQUIST_PHASE_INCREMENT ? (uint32_t)transposed : NYQUIST_PHASE_INCREMENT;
+    }
+
+    // Voices run on the output timeline: score durations are stretched by the tempo
+    uint32_t length = live_id ? LIVE_NOTE_SUSTAIN : output_duration(seq, event);
+
+    if (pool->num_active - pool->num_fading >= max_voices && !steal_voice(seq, pitch)) {
+        seq->events_dropped++;
+        RT_LOG(RT_LOG_EVENT_DROPPED, event_index, seq->current_sample_index);
+        return false;
+    }
+
+    uint32_t start = (uint32_t)seq->current_sample_index - elapsed;
+    voice_pool_activate(pool, event, event_index, pitch, start, start + length, live_id);
+
+    // Oscillators are memoryless, so their phase after `elapsed` samples is exact
+    if (elapsed > 0) {
+        int base = (pool->num_active - 1) * MAX_PARTIALS;
+        for (int p = 0; p < pool->num_partials[pool->num_active - 1]; p++) {
+            pool->phase_accum[base + p] = pool->phase_increment[base + p] * elapsed;
+        }
+    }
+    RT_LOG(RT_LOG_EVENT_ACTIVATED, event_index, seq->current_sample_index);
+    return true;
+}
+
+// Activate all events whose start time has been reached
+static void activate_pending_events(sequencer_state_t* seq) {
+    const event_t* event;
+    while ((event = peek_next_event(seq)) && ((uint64_t)event->start_sample << 16) <= seq->score_position) {
+        activate_event(seq, event, seq->next_event_index, 0, 0);
+        advance_next_event(seq);
+    }
+}
+
+// Length of the next span that can be rendered without any event starting or entering release
+static size_t next_block_boundary(sequencer_state_t* seq, size_t max_samples) {
+    size_t span = max_samples < RENDER_BLOCK_SIZE ? max_samples : RENDER_BLOCK_SIZE;
+
+    const event_t* next = peek_next_event(seq);
+    if (next && ((uint64_t)next->start_sample << 16) > seq->score_position) {
+        uint64_t until_start = score_to_output_samples(seq, ((uint64_t)next->start_sample << 16) - seq->score_position);
+        if (until_start < span) {
+            span = (size_t)until_start;
+        }
+    }
+
+    for (int v = 0; v < seq->voices.num_active; v++) {
+        int32_t samples_until_release = (int32_t)(seq->voices.release_sample[v] - (uint32_t)seq->current_sample_index);
+        if (samples_until_release > 0 && (size_t)samples_until_release < span) {
+            span = (size_t)samples_until_release;
+        }
+    }
+
+    return span;
+}
+
+// Remove events that have completed their release phase (backwards iteration for safe removal)
+static void remove_finished_events(sequencer_state_t* seq, uint64_t last_sample_index) {
+    voice_pool_t* pool = &seq->voices;
+
+    for (int v = pool->num_active - 1; v >= 0; v--) {
+        if (pool->fading[v]) {
+            // Stolen voice: remove once its fade-out has finished
+            if (pool->fade_remaining[v] == 0) {
+                voice_pool_remove(pool, v);
+            }
+        } else if (pool->instrument[v] && pool->instrument[v]->envelope == adsr_envelope) {
+            // For ADSR: remove when in release phase and envelope has decayed to near zero
+            int32_t samples_until_release = pool->release_sample[v] - last_sample_index;
+
+            if (samples_until_release <= 0 && pool->envelope_level[v] == 0) {
+                // Release phase and exponential decay has reached zero
+                RT_LOG(RT_LOG_EVENT_COMPLETED, pool->event_index[v], last_sample_index);
+                voice_pool_remove(pool, v);
+            } else if (samples_until_release <= 0 && seq->cull_level > 0 &&
+                       voice_output_level(seq, v) < AUDIBLE_THRESHOLD) {
+                // Over the CPU budget: stop rendering an inaudible tail instead of decaying it to zero
+                RT_LOG(RT_LOG_EVENT_INAUDIBLE, pool->event_index[v], last_sample_index);
+                voice_pool_remove(pool, v);
+                seq->voices_culled++;
+            }
+        } else {
+            // For other envelope types, use the threshold method
+            if (get_current_envelope_level(pool, v) < AUDIBLE_THRESHOLD) {
+                RT_LOG(RT_LOG_EVENT_INAUDIBLE, pool->event_index[v], last_sample_index);
+                voice_pool_remove(pool, v);
             }
         }
+    }
+}
+
+// ============================================================================
+// LIVE CONTROL
+// ============================================================================
+
+bool sequencer_post(sequencer_state_t* seq, const sequencer_command_t* command) {
+    sequencer_command_queue_t* queue = &seq->commands;
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail >= SEQUENCER_COMMAND_CAPACITY) {
+        return false;
+    }
+
+    queue->slots[head % SEQUENCER_COMMAND_CAPACITY] = *command;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+static bool post_value(sequencer_state_t* seq, sequencer_command_type_t type, double value) {
+    if (!(value > 0.0)) {
+        value = 0.0;
+    }
+    sequencer_command_t command = {.type = type, .value = (uint32_t)(value * Q16_ONE + 0.5)};
+    return sequencer_post(seq, &command);
+}
+
+bool sequencer_set_tempo(sequencer_state_t* seq, float speed) {
+    if (speed < 1.0f / 16.0f) {
+        speed = 1.0f / 16.0f; // Keep the score moving
+    } else if (speed > 16.0f) {
+        speed = 16.0f;
+    }
+    return post_value(seq, SEQ_COMMAND_TEMPO, speed);
+}
+
+bool sequencer_set_transpose(sequencer_state_t* seq, float semitones) {
+    if (semitones < -96.0f) {
+        semitones = -96.0f;
+    } else if (semitones > 48.0f) {
+        semitones = 48.0f;
+    }
+    return post_value(seq, SEQ_COMMAND_TRANSPOSE, pow(2.0, semitones / 12.0));
+}
+
+bool sequencer_set_volume(sequencer_state_t* seq, float gain) {
+    return post_value(seq, SEQ_COMMAND_VOLUME, gain > 4.0f ? 4.0f : gain);
+}
+
+bool sequencer_note_on(sequencer_state_t* seq, uint32_t note_id, const instrument_t* instrument,
+                       uint32_t phase_increment, float volume, int8_t pan) {
+    if (note_id == 0 || phase_increment == 0) {
+        return false;
+    }
+    if (!instrument) {
+        instrument = &pluck_sine_instrument; // The parser's default
+    }
+
+    sequencer_command_t command = {.type = SEQ_COMMAND_NOTE_ON, .note_id = note_id};
+    event_t* event = &command.event;
+    event->duration_samples = LIVE_NOTE_SUSTAIN;
+    event->release_sample = LIVE_NOTE_SUSTAIN;
+    event->instrument = instrument;
+    event->partials = instrument_partial_table(instrument);
+    event->phase_increment = phase_increment;
+    event->volume_scale = (int32_t)(volume * 0x10000000); // Same scale as sequenced notes
+    event->pan = pan;
+    setup_envelope_state(event, seq->sample_rate);
+
+    return sequencer_post(seq, &command);
+}
+
+bool sequencer_note_off(sequencer_state_t* seq, uint32_t note_id) {
+    sequencer_command_t command = {.type = SEQ_COMMAND_NOTE_OFF, .note_id = note_id};
+    return sequencer_post(seq, &command);
+}
+
+// Release a live note now (the span starting here is its first release sample)
+static void release_live_note(sequencer_state_t* seq, uint32_t note_id) {
+    voice_pool_t* pool = &seq->voices;
+    uint32_t now = (uint32_t)seq->current_sample_index;
+
+    for (int v = 0; v < pool->num_active; v++) {
+        if (pool->live_id[v] == note_id && !pool->fading[v] && (int32_t)(pool->release_sample[v] - now) > 0) {
+            pool->release_sample[v] = now;
+        }
+    }
+}
+
+// Fade out everything sounding, dropping voices that have no fade slot left
+static void silence_voices(sequencer_state_t* seq) {
+    voice_pool_t* pool = &seq->voices;
+
+    for (int v = pool->num_active - 1; v >= 0; v--) {
+        if (pool->fading[v]) {
+            continue;
+        }
+        if (pool->num_fading < MAX_FADING_VOICES) {
+            pool->fading[v] = true;
+            pool->fade_remaining[v] = STEAL_FADE_SAMPLES;
+            pool->num_fading++;
+        } else {
+            voice_pool_remove(pool, v);
+        }
+    }
+}
+
+// ============================================================================
+// SEEKING
+// ============================================================================
+
+// Events addressable by index: a fully sequenced array or a compiled score's records
+static bool score_is_indexed(const sequencer_state_t* seq) { return !seq->stream || seq->stream->records; }
+
+static uint32_t indexed_event_count(const sequencer_state_t* seq) {
+    return seq->stream ? seq->stream->num_records : (uint32_t)seq->events.count;
+}
+
+static uint32_t indexed_event_start(const sequencer_state_t* seq, uint32_t i) {
+    return seq->stream ? seq->stream->records[i].start_sample : seq->events.data[i].start_sample;
+}
+
+// First indexed event starting at or after `sample` (events are sorted by start)
+static uint32_t lower_bound_event(const sequencer_state_t* seq, uint64_t sample) {
+    uint32_t lo = 0;
+    uint32_t hi = indexed_event_count(seq);
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (indexed_event_start(seq, mid) < sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// One pass over the score for the longest duration and envelope tail, bounding how long before a
+// seek target an event can start and still be sounding
+static void build_seek_index(sequencer_state_t* seq) {
+    seek_index_t* index = &seq->seek_index;
+    uint32_t count = indexed_event_count(seq);
+    const instrument_t* last_instrument = NULL;
+    int32_t last_coeff = 0;
+    uint32_t last_tail = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        event_t decoded;
+        const event_t* event = &decoded;
+        if (seq->stream) {
+            score_decode_event(&seq->stream->records[i], &decoded);
+        } else {
+            event = &seq->events.data[i]; // Streams have no event array
+        }
+
+        uint32_t duration = event->release_sample - event->start_sample;
+        if (duration > index->max_duration) {
+            index->max_duration = duration;
+        }
+
+        // Tails only depend on the envelope coefficients, which repeat across a score
+        int32_t coeff = event->envelope_state.adsr.release_coeff;
+        if (event->instrument != last_instrument || coeff != last_coeff || i == 0) {
+            last_tail = envelope_tail_samples(event->instrument, &event->envelope_state);
+            last_instrument = event->instrument;
+            last_coeff = coeff;
+        }
+        // Envelopes with no known end are not resumed, so they need no lookback
+        if (last_tail > index->max_tail && last_tail < ENVELOPE_UNBOUNDED_LIFETIME) {
+            index->max_tail = last_tail;
+        }
+    }
+
+    index->ready = true;
+}
 
-        seq->current_sample_index++;
+// Start an event that began before the seek target mid-note, if it is still sounding there
+static void resume_event(sequencer_state_t* seq, const event_t* event, uint64_t target) {
+    uint64_t elapsed = ((target - event->start_sample) << 16) / tempo_scale(seq);
+    if (elapsed >= LIVE_NOTE_SUSTAIN) {
+        return; // Long gone (or a never-ending envelope we will not resurrect)
     }
 
-    // Check if song is complete
-    if (seq->num_active == 0 && seq->next_event_index >= seq->events.count) {
-        printf("Song complete, marking as finished\n");
+    event_t resumed = *event;
+    if (envelope_fast_forward(resumed.instrument, &resumed.envelope_state, (uint32_t)elapsed,
+                              output_duration(seq, event))) {
+        activate_event(seq, &resumed, seq->next_event_index, 0, (uint32_t)elapsed);
+    }
+}
+
+// Move the score to `position`: indexed scores binary-search the first event that could still be
+// sounding there, text streams rewind if needed and walk. Events started before the target are
+// resumed mid-note with their envelopes fast-forwarded; the rest play as usual.
+static void seek_score(sequencer_state_t* seq, uint64_t position) {
+    if (score_is_indexed(seq)) {
+        if (!seq->seek_index.ready) {
+            build_seek_index(seq);
+        }
+
+        uint64_t lookback = seq->seek_index.max_duration + (((uint64_t)seq->seek_index.max_tail *
+                                                              tempo_scale(seq)) >> 16) + 1;
+        uint64_t max_lookback = (uint64_t)SEEK_MAX_LOOKBACK_SECONDS * seq->sample_rate;
+        if (lookback > max_lookback) {
+            lookback = max_lookback; // Bounds the events walked (and resumed) below
+        }
+        uint32_t first = lower_bound_event(seq, position > lookback ? position - lookback : 0);
+        seq->next_event_index = (int)first;
+        if (seq->stream) {
+            seq->stream->head = 0;
+            seq->stream->tail = 0;
+            seq->stream->next_record = first;
+        }
+    } else if (position << 16 < seq->score_position) {
+        // A stream can only be read front to back
+        seq->next_event_index = 0;
+        event_stream_rewind(seq->stream);
+    }
+
+    seq->score_position = position << 16;
+    seq->completed = false;
+
+    const event_t* event;
+    while ((event = peek_next_event(seq)) && event->start_sample < position) {
+        resume_event(seq, event, position);
+        advance_next_event(seq);
+    }
+}
+
+bool sequencer_seek(sequencer_state_t* seq, uint64_t score_sample) {
+    // A text stream would re-parse up to the target on the audio thread; it can only be located
+    if (!score_is_indexed(seq)) {
+        return false;
+    }
+    // The index is one pass over the score, so build it here rather than on the audio thread
+    if (!seq->seek_index.ready) {
+        build_seek_index(seq);
+    }
+
+    sequencer_command_t command = {.type = SEQ_COMMAND_SEEK, .position = score_sample};
+    return sequencer_post(seq, &command);
+}
+
+void sequencer_locate(sequencer_state_t* seq, uint64_t score_sample) {
+    seq->voices.num_active = 0;
+    seq->voices.num_fading = 0;
+    seek_score(seq, score_sample);
+}
+
+// Drain the command queue (audio thread, at a span boundary)
+static void apply_commands(sequencer_state_t* seq) {
+    sequencer_command_queue_t* queue = &seq->commands;
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    for (; tail != head; tail++) {
+        const sequencer_command_t* command = &queue->slots[tail % SEQUENCER_COMMAND_CAPACITY];
+
+        switch (command->type) {
+        case SEQ_COMMAND_TEMPO:
+            seq->tempo_scale = command->value ? command->value : Q16_ONE;
+            break;
+        case SEQ_COMMAND_TRANSPOSE:
+            seq->pitch_ratio = command->value == Q16_ONE ? 0 : command->value;
+            break;
+        case SEQ_COMMAND_VOLUME:
+            seq->master_volume = command->value;
+            seq->volume_set = true;
+            break;
+        case SEQ_COMMAND_NOTE_ON:
+            activate_event(seq, &command->event, -1, command->note_id, 0);
+            break;
+        case SEQ_COMMAND_NOTE_OFF:
+            release_live_note(seq, command->note_id);
+            break;
+        case SEQ_COMMAND_SEEK:
+            silence_voices(seq);
+            seek_score(seq, command->position);
+            break;
+        }
+    }
+
+    atomic_store_explicit(&queue->tail, tail, memory_order_release);
+}
+
+// Render the next span (up to the next start/release boundary, at most max_samples) into the mix
+static size_t render_span(sequencer_state_t* seq, int32_t* mix, size_t stride, int planes, size_t max_samples) {
+    // 0. Apply live-control commands posted since the last span
+    apply_commands(seq);
+
+    // 1. Activate new events that should start now
+    activate_pending_events(seq);
+
+    // 2. Render every active event over the span up to the next start/release boundary, with
+    // the quietest partials culled when over the CPU budget
+    size_t span = next_block_boundary(seq, max_samples);
+    if (seq->cpu_budget) {
+        cull_partials(seq);
+    }
+    if (seq->voices.num_active > seq->peak_voices) {
+        seq->peak_voices = seq->voices.num_active;
+    }
+    uint32_t master_volume = master_gain(seq);
+    for (int v = 0; v < seq->voices.num_active; v++) {
+        render_voice_block(&seq->voices, v, mix, stride, planes, master_volume, span,
+                           (uint32_t)seq->current_sample_index);
+    }
+
+    // 3. Remove events that finished during this span
+    remove_finished_events(seq, seq->current_sample_index + span - 1);
+
+    seq->current_sample_index += span;
+    seq->score_position += (uint64_t)span * tempo_scale(seq);
+    return span;
+}
+
+// Check if song is complete
+static bool song_finished(sequencer_state_t* seq) {
+    if (seq->voices.num_active == 0 && !peek_next_event(seq)) {
+        if (!seq->completed) {
+            RT_LOG(RT_LOG_SONG_COMPLETE, 0, seq->current_sample_index);
+        }
         seq->completed = true;
-        return false; // Tell audio driver to stop calling us
+        return true;
     }
+    return false;
+}
+
+static int clamp_planes(int planes) {
+    if (planes < 1) {
+        return 1;
+    }
+    return planes > MIX_BUS_PLANES ? MIX_BUS_PLANES : planes;
+}
+
+bool sequencer_render(sequencer_state_t* seq, int32_t* mix, size_t stride, int planes, size_t num_frames) {
+    planes = clamp_planes(planes);
+    seq->peak_voices = 0;
 
-    return true; // Continue playback
+    size_t pos = 0;
+    while (pos < num_frames) {
+        pos += render_span(seq, mix + pos, stride, planes, num_frames - pos);
+    }
+
+    return !song_finished(seq);
+}
+
+static inline int32_t saturate_s16(int32_t sample) {
+    if (sample > INT16_MAX) {
+        return INT16_MAX;
+    }
+    return sample < INT16_MIN ? INT16_MIN : sample;
+}
+
+void mix_bus_convert(const int32_t* mix, size_t stride, int planes, size_t num_frames, const audio_format_t* format,
+                     void* buffer, size_t first_frame) {
+    const size_t channels = format->channels;
+    planes = clamp_planes(planes);
+
+    // Output channel c takes plane c % planes (mono is copied everywhere, stereo alternates)
+    for (size_t c = 0; c < channels; c++) {
+        const int32_t* plane = mix + (c % (size_t)planes) * stride;
+        size_t out = first_frame * channels + c;
+
+        switch (format->format) {
+        case AUDIO_FORMAT_S16: {
+            int16_t* samples = buffer;
+            for (size_t i = 0; i < num_frames; i++, out += channels) {
+                samples[out] = (int16_t)saturate_s16(plane[i]);
+            }
+            break;
+        }
+        case AUDIO_FORMAT_S32: {
+            int32_t* samples = buffer;
+            for (size_t i = 0; i < num_frames; i++, out += channels) {
+                samples[out] = (int32_t)((uint32_t)saturate_s16(plane[i]) << 16);
+            }
+            break;
+        }
+        case AUDIO_FORMAT_F32: {
+            float* samples = buffer;
+            for (size_t i = 0; i < num_frames; i++, out += channels) {
+                samples[out] = (float)saturate_s16(plane[i]) * (1.0f / 32768.0f);
+            }
+            break;
+        }
+        }
+    }
+}
+
+bool sequencer_callback(void* buffer, size_t num_frames, const audio_format_t* format, void* user_data) {
+    sequencer_state_t* seq = (sequencer_state_t*)user_data;
+    int planes = clamp_planes((int)format->channels);
+    size_t pos = 0;
+    seq->peak_voices = 0;
+    uint64_t render_start = seq->cpu_budget ? RT_STATS_NOW() : 0;
+
+    while (pos < num_frames) {
+        int32_t mix[MIX_BUS_PLANES * RENDER_BLOCK_SIZE];
+        memset(mix, 0, planes * RENDER_BLOCK_SIZE * sizeof(int32_t));
+
+        size_t span = render_span(seq, mix, RENDER_BLOCK_SIZE, planes, num_frames - pos);
+        mix_bus_convert(mix, RENDER_BLOCK_SIZE, planes, span, format, buffer, pos);
+        pos += span;
+    }
+
+    if (seq->cpu_budget) {
+        adapt_quality(seq, RT_STATS_NOW() - render_start, num_frames);
+    }
+    RT_STATS_VOICES(seq->peak_voices);
+    return !song_finished(seq); // false tells the audio driver to stop calling us
 }
 
 void cleanup_sequencer_state(sequencer_state_t* seq) {
@@ -262,5 +1419,6 @@ void cleanup_sequencer_state(sequencer_state_t* seq) {
         return;
 
     event_array_free(&seq->events);
+    free(seq->stream);
     free(seq);
 }
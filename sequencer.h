@@ -1,85 +1,311 @@
 #ifndef MUSIC_H
 #define MUSIC_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "audio_driver.h"
 #include "instrument.h"
+#include "oscillator.h"
 #include "parser.h"
 
 // ============================================================================
 // MUSIC SYSTEM TYPES
 // ============================================================================
 
+// Score event: immutable once sequenced, so a score can be shared by several players.
+// All mutable render state lives in the voice pool the event is copied into on activation.
 typedef struct {
-    uint32_t phase_accum; // Unsigned for proper DDS wraparound
-    uint32_t phase_increment; // Unsigned phase increment per sample
-    int32_t amplitude; // Q1.31 amplitude for this partial
-} partial_t;
-
-typedef struct {
-    // === Timing (immutable) ===
+    // === Timing ===
     uint32_t start_sample;
     uint32_t duration_samples;
     uint32_t release_sample;
 
-    // === Audio Properties (immutable) ===
+    // === Audio Properties ===
     const instrument_t* instrument;
+    const partial_table_t* partials; // Instrument partials, expanded at phase_increment on activation
+    uint32_t phase_increment; // Fundamental phase increment per sample
     int32_t volume_scale;
+    int8_t pan; // -127 = hard left, 0 = centre, 127 = hard right
 
-    // === Envelope State (mutable) ===
-    union {
-        pluck_decay_t pluck;
-        adsr_t adsr;
-    } envelope_state;
-
-    // === Variable Partial Data ===
-    uint8_t num_partials;
-    partial_t partials[MAX_PARTIALS];
+    // === Initial Envelope State ===
+    envelope_state_t envelope_state;
 } event_t;
 
 DEFINE_ARRAY_TYPE(event, event_t)
 
-#define MAX_SIMULTANEOUS_EVENTS 32
+#define MAX_SIMULTANEOUS_EVENTS 32 // Maximum polyphony (sounding voices)
+#define MAX_FADING_VOICES 8 // Extra slots for stolen voices fading out
+#define MAX_VOICE_SLOTS (MAX_SIMULTANEOUS_EVENTS + MAX_FADING_VOICES)
+#define STEAL_FADE_SAMPLES 64 // Fade-out length of a stolen voice (~1.5ms at 44.1kHz)
 #define AUDIBLE_THRESHOLD 0x00001000 // Much lower threshold - about 0.1% of full scale
+#define RENDER_BLOCK_SIZE 256 // Maximum samples rendered per voice in one contiguous span
+#define MIX_BUS_PLANES 2 // Rendered channels: mono, or left/right (further output channels repeat them)
+#define PAN_UNITY_GAIN 0x80000000u // Pan gain of exactly 1.0 in Q1.31 (held in a uint32)
+#define PHASE_TABLE_SEMITONES 128 // Absolute semitones covered by the phase increment tables (C0 up)
+#define Q16_ONE 0x10000u // 1.0 in the Q16.16 live-control values
+#define SEQUENCER_COMMAND_CAPACITY 64 // Pending live-control commands (must be a power of two)
+#define LIVE_NOTE_SUSTAIN 0x40000000u // Samples an injected note sustains for without a note-off
+#define SEEK_MAX_LOOKBACK_SECONDS 30 // Notes started longer than this before a seek target are not resumed
+#define CULL_LEVEL_MAX 0x00400000 // Adaptive quality never culls partials louder than this (Q1.31, -54 dB)
 
+#ifndef EVENT_STREAM_CAPACITY
+#define EVENT_STREAM_CAPACITY 256 // Sequenced-ahead events held by a streaming score
+#endif
+
+typedef struct score_event_record score_event_record_t; // Compiled score record (score_file.h)
+
+// Streaming score: parses and sequences a window of notes at a time into a bounded ring, so
+// playback can start immediately and memory stays constant however long the score is.
+// A compiled score is streamed the same way, decoding its records instead of parsing.
+// Indices are free-running; ring slot = index % EVENT_STREAM_CAPACITY.
 typedef struct {
-    event_array_t events;
+    parse_cursor_t cursor;
+    event_t ring[EVENT_STREAM_CAPACITY];
+    uint32_t head; // Next slot to sequence into
+    uint32_t tail; // Next event to activate
+
+    // === Compiled Score Source (used instead of the cursor when records is set) ===
+    const score_event_record_t* records;
+    uint32_t num_records;
+    uint32_t next_record;
+
+    const char* score; // Start of the score text, for rewinding on a seek
+
+    // === Sequencing Parameters ===
+    uint32_t sample_rate;
+    uint64_t beat_length; // Samples per beat, Q48.16
+    const key_signature_t* key;
+    const temperament_t* temperament;
+    int transposition;
+    float volume;
+    uint64_t current_position; // Start time of the next note, Q48.16 samples
+} event_stream_t;
+
+// What to do with a new event when the polyphony limit is reached
+typedef enum {
+    VOICE_STEAL_QUIETEST, // Fade out the voice with the lowest envelope level (default)
+    VOICE_STEAL_OLDEST, // Fade out the voice that started first
+    VOICE_STEAL_SAME_PITCH, // Retrigger a voice already playing this pitch, else steal the quietest
+    VOICE_STEAL_NONE, // Drop the new event
+} voice_steal_policy_t;
+
+// Fixed-size structure-of-arrays voice pool. Voices [0, num_active) are live and densely
+// packed: removing a voice moves the last one into its slot. Stolen voices keep their slot
+// while they fade out, but no longer count against the polyphony limit.
+typedef struct {
+    // === Oscillator Bank (partial p of voice v at [v * MAX_PARTIALS + p]) ===
+    uint32_t phase_accum[MAX_VOICE_SLOTS * MAX_PARTIALS];
+    uint32_t phase_increment[MAX_VOICE_SLOTS * MAX_PARTIALS];
+    int32_t amplitude[MAX_VOICE_SLOTS * MAX_PARTIALS];
+    uint8_t num_partials[MAX_VOICE_SLOTS]; // Additive partials are sorted loudest first
+    uint8_t rendered_partials[MAX_VOICE_SLOTS]; // Leading partials rendered, fewer than num_partials if culled
+    const int32_t* wavetable[MAX_VOICE_SLOTS]; // Band-limited table driven by partial 0, NULL = additive
+
+    // === Envelopes ===
+    envelope_state_t envelope[MAX_VOICE_SLOTS];
+    int32_t envelope_level[MAX_VOICE_SLOTS]; // Q1.31 level after the last rendered span
+    bool fading[MAX_VOICE_SLOTS]; // Stolen, fading out over STEAL_FADE_SAMPLES
+    uint32_t fade_remaining[MAX_VOICE_SLOTS]; // Samples left in the fade
+
+    // === Per-Voice Event Data ===
+    const instrument_t* instrument[MAX_VOICE_SLOTS];
+    uint32_t start_sample[MAX_VOICE_SLOTS];
+    uint32_t release_sample[MAX_VOICE_SLOTS];
+    uint32_t pitch[MAX_VOICE_SLOTS]; // Fundamental phase increment, for same-pitch retrigger
+    int32_t volume_scale[MAX_VOICE_SLOTS];
+    uint32_t live_id[MAX_VOICE_SLOTS]; // Note id of an injected note, 0 for score events
+    uint32_t pan_left[MAX_VOICE_SLOTS]; // Balance gains, PAN_UNITY_GAIN on the panned-towards side
+    uint32_t pan_right[MAX_VOICE_SLOTS];
+    int event_index[MAX_VOICE_SLOTS]; // Source event in the score
+
+    int num_active;
+    int num_fading;
+} voice_pool_t;
+
+typedef enum {
+    SEQ_COMMAND_TEMPO, // value: Q16.16 playback speed relative to the sequenced tempo
+    SEQ_COMMAND_TRANSPOSE, // value: Q16.16 pitch ratio for notes started from now on
+    SEQ_COMMAND_VOLUME, // value: Q16.16 master gain on every voice
+    SEQ_COMMAND_NOTE_ON, // Start `event` now as live note note_id
+    SEQ_COMMAND_NOTE_OFF, // Release live note note_id
+    SEQ_COMMAND_SEEK, // position: score sample to continue from
+} sequencer_command_type_t;
+
+typedef struct {
+    sequencer_command_type_t type;
+    uint32_t note_id;
+    uint32_t value;
+    uint64_t position;
+    event_t event;
+} sequencer_command_t;
+
+// Single producer (one control thread), single consumer (the audio thread, which applies
+// commands at the start of each rendered span). Indices are free-running; slot =
+// index % SEQUENCER_COMMAND_CAPACITY.
+typedef struct {
+    sequencer_command_t slots[SEQUENCER_COMMAND_CAPACITY];
+    atomic_uint head; // Next slot to post into (producer)
+    atomic_uint tail; // Next command to apply (audio thread)
+} sequencer_command_queue_t;
+
+// Built by the first seek of an indexed score (event array or compiled records), on the calling
+// thread: how far before a seek target an event can start and still be sounding
+typedef struct {
+    bool ready;
+    uint32_t max_duration; // Longest start-to-release, in score samples
+    uint32_t max_tail; // Longest envelope tail after the release, in output samples
+} seek_index_t;
+
+typedef struct {
+    event_array_t events; // Read-only during playback (sorted by start_sample)
+    event_stream_t* stream; // Streaming score instead of events, NULL for a fully sequenced one
     uint32_t sample_rate;
     uint64_t current_sample_index;
     uint64_t total_duration_samples; // Total song length
-    int next_event_index;
-    event_t* active_events[MAX_SIMULTANEOUS_EVENTS];
-    int num_active;
+    int next_event_index; // Events consumed so far (index into events unless streaming)
+    voice_pool_t voices;
+    int max_voices; // Polyphony limit, 0 = MAX_SIMULTANEOUS_EVENTS
+    voice_steal_policy_t steal_policy;
+    uint32_t voices_stolen; // Voices faded out to make room for a new event
+    uint32_t events_dropped; // Events that could not get a voice
+    int peak_voices; // Most voices active in one span during the last callback or render (instrumentation)
     bool completed; // Set by callback when song ends, checked by main thread
+
+    // === Live Control (only touched by the audio thread, apart from the queue itself) ===
+    sequencer_command_queue_t commands;
+    uint64_t score_position; // Q48.16 position on the events' timeline, advancing tempo_scale per sample
+    uint32_t tempo_scale; // Q16.16 score samples per output sample, 0 = as sequenced
+    uint32_t pitch_ratio; // Q16.16 applied to newly started notes, 0 = untransposed
+    uint32_t master_volume; // Q16.16 gain on every voice, once volume_set
+    bool volume_set;
+    seek_index_t seek_index;
+
+    // === Adaptive Quality (see sequencer_set_cpu_budget) ===
+    uint32_t cpu_budget; // Q16.16 share of a quantum's playback time its render may take, 0 = unlimited
+    uint32_t render_load; // Q16.16 render time / playback time, following peaks and decaying slowly
+    int32_t cull_level; // Q1.31 output level below which partials are skipped, 0 = full quality
+    uint32_t voices_culled; // Inaudible voices removed early while culling
 } sequencer_state_t;
 
 // ============================================================================
 // MUSIC SYSTEM FUNCTIONS
 // ============================================================================
 
-// Initialize sine table (call once at startup)
+// Initialize sine table, oscillator kernels and instrument partial tables (call once at startup)
 void music_init(void);
 
-// Generate one sample from an event
-int16_t generate_event_sample(event_t* event, uint32_t current_sample_index);
+// Print a summary line for every sequenced score (on by default; tools with their own report turn it off)
+extern bool sequencer_verbose;
+
+// Adaptive quality: keep each sequencer_callback within `share` of its quantum's playback time
+// (e.g. 0.7). While the render runs over, the quietest partials (amplitude x envelope x volume)
+// and inaudible released voices are culled, the cull level rising towards CULL_LEVEL_MAX; as
+// headroom returns the partials are restored in phase. 0 turns it off. Set before playback.
+// Render times come from the rt_stats clock, so this does nothing with MUSICBOX_RT_STATS=0.
+void sequencer_set_cpu_budget(sequencer_state_t* seq, float share);
 
-// Get current envelope level for threshold checking
-int32_t get_current_envelope_level(event_t* event);
+// Get current envelope level of an active voice for threshold checking
+int32_t get_current_envelope_level(const voice_pool_t* pool, int voice);
 
 // Main sequencer callback function (audio system agnostic)
-bool sequencer_callback(int16_t* buffer, size_t num_samples, void* user_data);
+bool sequencer_callback(void* buffer, size_t num_frames, const audio_format_t* format, void* user_data);
+
+// Render num_frames into a planar mix bus without converting it: plane p (p < planes, at most
+// MIX_BUS_PLANES) starts at mix[p * stride] and is added to, at S16 scale with int32 headroom.
+// Returns false once the song has finished.
+bool sequencer_render(sequencer_state_t* seq, int32_t* mix, size_t stride, int planes, size_t num_frames);
+
+// Final output stage: saturate a planar mix bus (as rendered above) and interleave it into
+// frames [first_frame, first_frame + num_frames) of an output buffer in `format`
+void mix_bus_convert(const int32_t* mix, size_t stride, int planes, size_t num_frames, const audio_format_t* format,
+                     void* buffer, size_t first_frame);
 
 // Clean up sequencer state
 void cleanup_sequencer_state(sequencer_state_t* seq);
 
+// Live control, from a single thread other than the audio thread. Commands take effect at the
+// next span boundary; each call returns false (changing nothing) if the queue is full.
+bool sequencer_post(sequencer_state_t* seq, const sequencer_command_t* command);
+
+// Playback speed relative to the sequenced tempo (1.0 = unchanged). Sounding notes keep their length.
+bool sequencer_set_tempo(sequencer_state_t* seq, float speed);
+
+// Transpose notes started from now on (sounding notes keep their pitch)
+bool sequencer_set_transpose(sequencer_state_t* seq, float semitones);
+
+// Master gain on every voice, 0.0 to 4.0
+bool sequencer_set_volume(sequencer_state_t* seq, float gain);
+
+// Start a live note (note_id != 0) that sustains until sequencer_note_off, or decays by itself for
+// percussive envelopes (NULL instrument = the parser's default). The instrument's partial table is
+// looked up here, off the audio thread.
+bool sequencer_note_on(sequencer_state_t* seq, uint32_t note_id, const instrument_t* instrument,
+                       uint32_t phase_increment, float volume, int8_t pan);
+bool sequencer_note_off(sequencer_state_t* seq, uint32_t note_id);
+
+// Continue from a score sample position. Sounding voices fade out, and notes the target falls
+// inside resume mid-note (unless they began over SEEK_MAX_LOOKBACK_SECONDS before it, or have a
+// custom envelope). O(log n) for event arrays and compiled scores, after a one-off scan done here
+// on the first seek. Returns false for text streams, which would re-parse up to the target on the
+// audio thread (use sequencer_locate before playback), and when the command queue is full.
+bool sequencer_seek(sequencer_state_t* seq, uint64_t score_sample);
+
+// Same, applied immediately with a hard cut: for starting playback at a time (or a loop region)
+// before the sequencer is handed to a driver, or from the audio thread itself once a seek or
+// locate off it has built the index. Text streams rewind if needed and parse up to the target.
+void sequencer_locate(sequencer_state_t* seq, uint64_t score_sample);
+
 // Envelope functions
 int32_t pluck_envelope(void* state, uint32_t samples_since_start, int32_t samples_until_release);
 int32_t adsr_envelope(void* state, uint32_t samples_since_start, int32_t samples_until_release);
 
-// Helper function to convert parsed notes to sequencer events
-event_array_t sequence_events(const note_array_t* notes, uint16_t sample_rate, int tempo_bpm,
+// Phase increment per absolute semitone for a temperament at a sample rate (0 = unplayable).
+// Built on first use and shared. Lookups are lock-free and safe from any thread; a miss builds the
+// table under a lock, so build before the audio thread looks it up. NULL if the cache is full.
+const uint32_t* get_phase_increment_table(const temperament_t* temperament, uint32_t sample_rate);
+
+// Phase increment for a note, 0 for rests and pitches without a playable frequency
+uint32_t note_phase_increment(const note_t* note, const temperament_t* temperament, const key_signature_t* key,
+                              int transposition, uint32_t sample_rate);
+
+// Helper function to convert parsed notes to sequencer events. Each {name} track of the score runs
+// on its own timeline; the tracks are merged into one array sorted by start_sample. Empty (with a
+// message) if memory runs out.
+event_array_t sequence_events(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm,
                               const key_signature_t* key, const temperament_t* temperament, int transposition,
                               float volume);
 
+// Same, taking the array storage from an arena (released with the arena, not cleanup_sequencer_state)
+event_array_t sequence_events_arena(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm,
+                                    const key_signature_t* key, const temperament_t* temperament, int transposition,
+                                    float volume, arena_t* arena);
+
+// Sequence each track of a score into tracks[0..n) instead of merging them, returns n (the highest
+// track used + 1). Arrays are heap-allocated and sorted, so each can play as a multitrack track.
+// 0 (with a message, no arrays to free) if memory runs out.
+int sequence_tracks(const note_array_t* notes, uint32_t sample_rate, int tempo_bpm, const key_signature_t* key,
+                    const temperament_t* temperament, int transposition, float volume,
+                    event_array_t tracks[MAX_SCORE_TRACKS]);
+
+// k-way merge of event arrays sorted by start_sample into one sorted array (*merged), O(n log k).
+// Events starting together keep the order of their arrays. Returns false, with *merged left
+// empty, if it cannot be allocated.
+bool merge_event_arrays(const event_array_t* arrays, int count, event_array_t* merged);
+bool merge_event_arrays_arena(const event_array_t* arrays, int count, arena_t* arena, event_array_t* merged);
+
+// Streaming alternative to sequence_events: the score string must outlive the stream. Notes are
+// sequenced in text order on one timeline, so {name} tracks need sequence_events instead.
+void event_stream_init(event_stream_t* stream, const char* score, uint32_t sample_rate, int tempo_bpm,
+                       const key_signature_t* key, const temperament_t* temperament, int transposition,
+                       float volume);
+int event_stream_fill(event_stream_t* stream); // Returns the number of events added
+
+// Create a sequencer that plays a score as it is parsed (free with cleanup_sequencer_state).
+// NULL for a score with {name} tracks, which only sequence_events can put on their own timelines.
+sequencer_state_t* create_streaming_sequencer(const char* score, uint32_t sample_rate, int tempo_bpm,
+                                              const key_signature_t* key, const temperament_t* temperament,
+                                              int transposition, float volume);
+
 #endif // MUSIC_H
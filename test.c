@@ -22,7 +22,6 @@ sequencer_state_t* create_simple_melody_test(uint32_t sample_rate) {
     seq->sample_rate = sample_rate;
     seq->current_sample_index = 0;
     seq->next_event_index = 0;
-    seq->num_active = 0;
     seq->completed = false;
 
     // Calculate total duration
@@ -56,7 +55,6 @@ sequencer_state_t* create_chord_test(uint32_t sample_rate) {
     seq->sample_rate = sample_rate;
     seq->current_sample_index = 0;
     seq->next_event_index = 0;
-    seq->num_active = 0;
     seq->completed = false;
 
     // Calculate total duration
@@ -77,19 +75,6 @@ sequencer_state_t* create_chord_test(uint32_t sample_rate) {
 }
 
 
-// Comparison function for qsort
-static int compare_events_by_start_time(const void* a, const void* b) {
-    const event_t* event_a = (const event_t*)a;
-    const event_t* event_b = (const event_t*)b;
-
-    if (event_a->start_sample < event_b->start_sample)
-        return -1;
-    if (event_a->start_sample > event_b->start_sample)
-        return 1;
-    return 0;
-}
-
-
 // Create multi-voice test (simple canon)
 sequencer_state_t* create_multi_voice_test(uint32_t sample_rate) {
     printf("Creating multi-voice test...\n");
@@ -104,26 +89,26 @@ sequencer_state_t* create_multi_voice_test(uint32_t sample_rate) {
     event_array_t events1 = sequence_events(&voice1, sample_rate, 140, &c_major, &equal_temperament, 0, 0.4f);
     event_array_t events2 = sequence_events(&voice2, sample_rate, 140, &c_major, &equal_temperament, 0, 0.4f);
 
-    // Merge events (we'll need to implement this)
-    event_array_t merged_events = {0};
-
-    // Add all events from both voices
+    // Spread the two voices left and right (mono output ignores pan)
     for (int i = 0; i < events1.count; i++) {
-        event_array_push(&merged_events, events1.data[i]);
+        events1.data[i].pan = -64;
     }
     for (int i = 0; i < events2.count; i++) {
-        event_array_push(&merged_events, events2.data[i]);
+        events2.data[i].pan = 64;
     }
 
-    // Sort by start time
-    qsort(merged_events.data, merged_events.count, sizeof(event_t), compare_events_by_start_time);
+    // Merge the two sorted voices by start time
+    const event_array_t voices[] = {events1, events2};
+    event_array_t merged_events;
+    if (!merge_event_arrays(voices, 2, &merged_events)) {
+        printf("Failed to merge the canon voices\n");
+    }
 
     sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
     seq->events = merged_events;
     seq->sample_rate = sample_rate;
     seq->current_sample_index = 0;
     seq->next_event_index = 0;
-    seq->num_active = 0;
     seq->completed = false;
 
     // Calculate total duration
@@ -165,7 +150,6 @@ sequencer_state_t* create_complex_test(uint32_t sample_rate) {
     seq->sample_rate = sample_rate;
     seq->current_sample_index = 0;
     seq->next_event_index = 0;
-    seq->num_active = 0;
     seq->completed = false;
 
     // Calculate total duration
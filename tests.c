@@ -0,0 +1,530 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "instrument.h"
+#include "parser.h"
+#include "sequencer.h"
+
+// Unit tests for behaviour the golden corpus (musicbox_bench --golden) cannot pin down on its own:
+// live control and the parser's edge cases. Exits non-zero if any check fails.
+
+#define TEST_SAMPLE_RATE 48000
+#define TEST_BLOCK_FRAMES 1024
+
+static int checks_run = 0;
+static int checks_failed = 0;
+
+#define CHECK(condition)                                                                                               \
+    do {                                                                                                               \
+        checks_run++;                                                                                                  \
+        if (!(condition)) {                                                                                            \
+            checks_failed++;                                                                                           \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #condition);                \
+        }                                                                                                              \
+    } while (0)
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+// Fully sequenced player for a score at 120 BPM in C major
+static sequencer_state_t* create_test_sequencer(const char* score) {
+    sequencer_state_t* seq = calloc(1, sizeof(sequencer_state_t));
+    if (!seq) {
+        return NULL;
+    }
+    note_array_t notes = parse_music(score);
+    seq->events = sequence_events(&notes, TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    seq->sample_rate = TEST_SAMPLE_RATE;
+    free_note_array(&notes);
+    return seq;
+}
+
+// Render num_frames of mono output into out[] (may be NULL), returning its RMS level in S16 units
+static double render_mono(sequencer_state_t* seq, int32_t* out, size_t num_frames) {
+    int32_t mix[TEST_BLOCK_FRAMES];
+    double energy = 0.0;
+    for (size_t done = 0; done < num_frames;) {
+        size_t frames = num_frames - done < TEST_BLOCK_FRAMES ? num_frames - done : TEST_BLOCK_FRAMES;
+        memset(mix, 0, frames * sizeof(int32_t));
+        sequencer_render(seq, mix, frames, 1, frames);
+        for (size_t i = 0; i < frames; i++) {
+            energy += (double)mix[i] * mix[i];
+        }
+        if (out) {
+            memcpy(out + done, mix, frames * sizeof(int32_t));
+        }
+        done += frames;
+    }
+    return num_frames ? sqrt(energy / (double)num_frames) : 0.0;
+}
+
+static uint32_t phase_increment_for(double frequency) {
+    return (uint32_t)(frequency / TEST_SAMPLE_RATE * 4294967296.0);
+}
+
+// ============================================================================
+// INSTRUMENTS
+// ============================================================================
+
+// Built-in tables exist after music_init, so looking them up never builds one on the audio thread
+static void test_partial_tables_prewarmed(void) {
+    for (int id = 0; id < NUM_INSTRUMENT_IDS; id++) {
+        const instrument_t* instrument = instrument_from_id((instrument_id_t)id);
+        const partial_table_t* table = instrument_partial_table(instrument);
+        CHECK(table != NULL);
+        CHECK(table == instrument_partial_table(instrument));
+        CHECK(table->num_partials > 0);
+    }
+}
+
+#define TEST_BUILDERS 4
+
+static atomic_int builders_waiting;
+
+static void* build_phase_table_main(void* arg) {
+    uint32_t sample_rate = (uint32_t)(uintptr_t)arg;
+    atomic_fetch_sub(&builders_waiting, 1);
+    while (atomic_load(&builders_waiting) > 0) {
+        // Start together, so the lookups all miss at once
+    }
+    return (void*)get_phase_increment_table(&werckmeister3_temperament, sample_rate);
+}
+
+// Threads missing the cache at the same time each get the table for their own sample rate
+static void test_phase_tables_concurrent(void) {
+    static const uint32_t rates[TEST_BUILDERS] = {8000, 11025, 16000, 22050};
+    pthread_t threads[TEST_BUILDERS];
+    int started = 0;
+    atomic_store(&builders_waiting, TEST_BUILDERS);
+    for (int t = 0; t < TEST_BUILDERS; t++) {
+        if (pthread_create(&threads[t], NULL, build_phase_table_main, (void*)(uintptr_t)rates[t]) == 0) {
+            started++;
+        }
+    }
+    CHECK(started == TEST_BUILDERS);
+    if (started != TEST_BUILDERS) {
+        atomic_store(&builders_waiting, 0);
+    }
+
+    const int semitone = 57; // A4
+    for (int t = 0; t < started; t++) {
+        void* table;
+        pthread_join(threads[t], &table);
+        CHECK(table != NULL);
+        CHECK(table == get_phase_increment_table(&werckmeister3_temperament, rates[t]));
+        if (table) {
+            double freq = werckmeister3_temperament.compute_frequency(semitone);
+            CHECK(((const uint32_t*)table)[semitone] == (uint32_t)(freq / rates[t] * 4294967296.0));
+        }
+    }
+}
+
+static void* build_partial_table_main(void* arg) {
+    atomic_fetch_sub(&builders_waiting, 1);
+    while (atomic_load(&builders_waiting) > 0) {
+        // Start together, as above
+    }
+    return (void*)instrument_partial_table(arg);
+}
+
+// Custom instruments built by several threads at once each get their own table
+static void test_partial_tables_concurrent(void) {
+    static instrument_t instruments[TEST_BUILDERS];
+    pthread_t threads[TEST_BUILDERS];
+    int started = 0;
+    atomic_store(&builders_waiting, TEST_BUILDERS);
+    for (int t = 0; t < TEST_BUILDERS; t++) {
+        instruments[t].envelope = adsr_envelope;
+        instruments[t].num_partials = 1;
+        instruments[t].harmonic_ratios[0] = (float)(t + 1); // Tells the tables apart
+        instruments[t].partial_amplitudes[0] = 1.0f;
+        if (pthread_create(&threads[t], NULL, build_partial_table_main, &instruments[t]) == 0) {
+            started++;
+        }
+    }
+    CHECK(started == TEST_BUILDERS);
+    if (started != TEST_BUILDERS) {
+        atomic_store(&builders_waiting, 0);
+    }
+
+    for (int t = 0; t < started; t++) {
+        void* table;
+        pthread_join(threads[t], &table);
+        CHECK(table == instrument_partial_table(&instruments[t]));
+        CHECK(((const partial_table_t*)table)->num_partials == 1);
+        CHECK(((const partial_table_t*)table)->ratio_q16[0] == (uint32_t)(t + 1) << 16);
+    }
+}
+
+// ============================================================================
+// PARSER
+// ============================================================================
+
+// The shortest note value parses, keeps its value and still advances the timeline
+static void test_parse_largest_value(void) {
+    note_array_t notes = parse_music("c128 d4 e128");
+    CHECK(notes.count == 3);
+    if (notes.count == 3) {
+        CHECK(notes.data[0].value == 128);
+        CHECK(notes.data[1].value == 4);
+        CHECK(notes.data[2].value == 128);
+    }
+
+    event_array_t events = sequence_events(&notes, TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    CHECK(events.count == 3);
+    if (events.count == 3) {
+        uint32_t shortest_note = TEST_SAMPLE_RATE / 2 / 32; // A 1/128 note at 120 BPM
+        CHECK(events.data[1].start_sample == shortest_note);
+        CHECK(events.data[2].start_sample == shortest_note + TEST_SAMPLE_RATE / 2);
+    }
+    event_array_free(&events);
+    free_note_array(&notes);
+
+    parse_diagnostic_t error;
+    notes = parse_music_diagnose("c256", NULL, &error);
+    CHECK(error.kind == PARSE_ERROR_INVALID_DURATION);
+    free_note_array(&notes);
+}
+
+// Errors are located by line and column, and stop the parse after the notes before them
+static void test_parse_error_position(void) {
+    parse_diagnostic_t error;
+    note_array_t notes = parse_music_diagnose("c4 d4\n  e4 x4 f4\ng4", NULL, &error);
+    CHECK(notes.count == 3);
+    CHECK(error.kind == PARSE_ERROR_UNEXPECTED_CHARACTER);
+    CHECK(error.line == 2);
+    CHECK(error.column == 6);
+    CHECK(error.offset == 11);
+    free_note_array(&notes);
+
+    notes = parse_music_diagnose("c4 <d f", NULL, &error);
+    CHECK(notes.count == 1);
+    CHECK(error.kind == PARSE_ERROR_UNTERMINATED_CHORD);
+    CHECK(error.line == 1 && error.column == 4);
+    free_note_array(&notes);
+
+    notes = parse_music_diagnose("c4 d4", NULL, &error);
+    CHECK(notes.count == 2);
+    CHECK(error.kind == PARSE_OK);
+    free_note_array(&notes);
+}
+
+// An unknown instrument is a warning: the rest of the score plays on the default instrument
+static void test_parse_unknown_instrument(void) {
+    parse_diagnostic_t error;
+    note_array_t notes = parse_music_diagnose("[square] c4 [kazoo] d4 e4", NULL, &error);
+    CHECK(notes.count == 3);
+    CHECK(error.kind == PARSE_ERROR_UNKNOWN_INSTRUMENT);
+    CHECK(error.line == 1 && error.column == 14);
+    if (notes.count == 3) {
+        CHECK(notes.data[0].instrument == &square_instrument);
+        CHECK(notes.data[1].instrument == lookup_instrument(NULL));
+        CHECK(notes.data[2].instrument == lookup_instrument(NULL));
+    }
+    free_note_array(&notes);
+}
+
+// In recover mode the cursor skips bad tokens and yields every good note
+static void test_parse_recover(void) {
+    parse_cursor_t cursor;
+    note_t notes[MAX_CHORD_SIZE];
+    parse_cursor_init(&cursor, "c4 x d4 c7 e4 <f a>2 [kazoo] b4 <c d");
+    cursor.recover = true;
+
+    char names[16];
+    int count = 0;
+    int n;
+    while ((n = parse_cursor_next(&cursor, notes)) > 0) {
+        for (int i = 0; i < n && count < (int)sizeof(names) - 1; i++) {
+            names[count++] = notes[i].note_name;
+        }
+    }
+    names[count] = '\0';
+    CHECK(strcmp(names, "cdefab") == 0);
+    CHECK(cursor.error_count == 4);
+    CHECK(cursor.error.kind == PARSE_ERROR_UNTERMINATED_CHORD);
+    CHECK(cursor.error.column == 33);
+}
+
+// parse_check stores the first diagnostics in order and counts them all
+static void test_parse_check(void) {
+    parse_diagnostic_t diagnostics[2];
+    CHECK(parse_check("c4 d4 <e g>2", diagnostics, 2) == 0);
+    CHECK(parse_check("c4 d4 <e g>2", NULL, 0) == 0);
+
+    int errors = parse_check("c4 x\nd3 [kazoo] e4\nq", diagnostics, 2);
+    CHECK(errors == 4);
+    CHECK(diagnostics[0].kind == PARSE_ERROR_UNEXPECTED_CHARACTER);
+    CHECK(diagnostics[0].line == 1 && diagnostics[0].column == 4);
+    CHECK(diagnostics[1].kind == PARSE_ERROR_INVALID_DURATION);
+    CHECK(diagnostics[1].line == 2 && diagnostics[1].column == 2); // At the value
+    CHECK(parse_check("c4 x\nd3 [kazoo] e4\nq", NULL, 0) == 4);
+}
+
+// ============================================================================
+// TRACKS
+// ============================================================================
+
+// Tracks run on their own timelines and merge into one sorted array
+static void test_track_merge(void) {
+    note_array_t notes = parse_music("{a} c4 d4 {b} e2 {a} f4 {} g4");
+    event_array_t events = sequence_events(&notes, TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    CHECK(events.count == 5);
+    for (int i = 1; i < events.count; i++) {
+        CHECK(events.data[i - 1].start_sample <= events.data[i].start_sample);
+    }
+    if (events.count == 5) {
+        CHECK(events.data[0].start_sample == 0); // c on track a, e on track b, g on the default track
+        CHECK(events.data[1].start_sample == 0);
+        CHECK(events.data[2].start_sample == 0);
+        CHECK(events.data[4].start_sample == TEST_SAMPLE_RATE); // f after c and d
+    }
+    event_array_free(&events);
+    free_note_array(&notes);
+
+    event_array_t merged;
+    CHECK(merge_event_arrays(NULL, 0, &merged));
+    CHECK(merged.count == 0);
+}
+
+// An even array count leaves the last heap parent with one child (the sift must not read past it)
+static void test_track_merge_many(void) {
+    enum { NUM_ARRAYS = 8 };
+    event_array_t arrays[NUM_ARRAYS];
+    int total = 0;
+    for (int a = 0; a < NUM_ARRAYS; a++) {
+        event_array_init(&arrays[a]);
+        for (int e = 0; e < a + 1; e++) {
+            event_t event = {0};
+            event.start_sample = (uint32_t)(e * 100 + (a % 3) * 10); // Ties across arrays
+            event.duration_samples = (uint32_t)a; // Records the source array
+            CHECK(event_array_push(&arrays[a], event));
+            total++;
+        }
+    }
+
+    event_array_t merged;
+    CHECK(merge_event_arrays(arrays, NUM_ARRAYS, &merged));
+    CHECK(merged.count == total);
+    for (int i = 1; i < merged.count; i++) {
+        const event_t* prev = &merged.data[i - 1];
+        const event_t* event = &merged.data[i];
+        CHECK(prev->start_sample < event->start_sample ||
+              (prev->start_sample == event->start_sample && prev->duration_samples < event->duration_samples));
+    }
+    event_array_free(&merged);
+    for (int a = 0; a < NUM_ARRAYS; a++) {
+        event_array_free(&arrays[a]);
+    }
+
+    note_array_t notes = parse_music("{a} c4 d {b} e4 f {c} g4 a {d} b4 c' {e} d'4 e'");
+    event_array_t events = sequence_events(&notes, TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    CHECK(events.count == 10);
+    for (int i = 1; i < events.count; i++) {
+        CHECK(events.data[i - 1].start_sample <= events.data[i].start_sample);
+    }
+    event_array_free(&events);
+    free_note_array(&notes);
+}
+
+// The streaming sequencer has one timeline, so it refuses named tracks
+static void test_stream_rejects_tracks(void) {
+    sequencer_state_t* seq =
+        create_streaming_sequencer("{a} c4 {b} e4", TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    CHECK(seq == NULL);
+    cleanup_sequencer_state(seq);
+
+    seq = create_streaming_sequencer("{} c4 e4", TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    CHECK(seq != NULL);
+    cleanup_sequencer_state(seq);
+}
+
+// ============================================================================
+// LIVE CONTROL
+// ============================================================================
+
+// A live note sounds until its note-off, then its release dies out and the voice is freed
+static void test_live_note_on_off(void) {
+    sequencer_state_t* seq = create_test_sequencer("r1 r1 r1 c4"); // Score silent for six seconds
+    CHECK(seq != NULL);
+    if (!seq) {
+        return;
+    }
+
+    CHECK(render_mono(seq, NULL, 4096) == 0.0);
+    CHECK(sequencer_note_on(seq, 1, &adsr_instrument, phase_increment_for(440.0), 0.5f, 0));
+    CHECK(!sequencer_note_on(seq, 0, &adsr_instrument, phase_increment_for(440.0), 0.5f, 0)); // Id 0 is reserved
+    CHECK(render_mono(seq, NULL, TEST_SAMPLE_RATE / 2) > 100.0);
+    CHECK(seq->voices.num_active == 1);
+
+    // Still sustaining a second later
+    CHECK(render_mono(seq, NULL, TEST_SAMPLE_RATE) > 100.0);
+
+    CHECK(sequencer_note_off(seq, 1));
+    render_mono(seq, NULL, TEST_SAMPLE_RATE * 2);
+    CHECK(seq->voices.num_active == 0);
+    CHECK(render_mono(seq, NULL, 4096) == 0.0);
+
+    cleanup_sequencer_state(seq);
+}
+
+// Master volume scales the whole output
+static void test_live_volume(void) {
+    const char* score = "c4 e4 <c e g>2";
+    sequencer_state_t* full = create_test_sequencer(score);
+    sequencer_state_t* half = create_test_sequencer(score);
+    CHECK(full && half);
+    if (full && half) {
+        CHECK(sequencer_set_volume(half, 0.5f));
+        double full_rms = render_mono(full, NULL, TEST_SAMPLE_RATE);
+        double half_rms = render_mono(half, NULL, TEST_SAMPLE_RATE);
+        CHECK(full_rms > 100.0);
+        CHECK(fabs(half_rms / full_rms - 0.5) < 0.01);
+    }
+    cleanup_sequencer_state(full);
+    cleanup_sequencer_state(half);
+}
+
+// Seeking to the last note skips the rest of the score, which then ends after that note
+static void test_seek(void) {
+    sequencer_state_t* seq = create_test_sequencer("c4 d4 e4 f4 g4 a4 b4 c'4");
+    CHECK(seq != NULL);
+    if (!seq) {
+        return;
+    }
+
+    uint32_t last_start = seq->events.data[seq->events.count - 1].start_sample;
+    render_mono(seq, NULL, 4096);
+    CHECK(sequencer_seek(seq, last_start));
+    CHECK(render_mono(seq, NULL, TEST_SAMPLE_RATE / 4) > 100.0);
+
+    bool more = true;
+    uint64_t frames = 4096 + TEST_SAMPLE_RATE / 4;
+    int32_t mix[TEST_BLOCK_FRAMES];
+    while (more && frames < (uint64_t)last_start) {
+        memset(mix, 0, sizeof(mix));
+        more = sequencer_render(seq, mix, TEST_BLOCK_FRAMES, 1, TEST_BLOCK_FRAMES);
+        frames += TEST_BLOCK_FRAMES;
+    }
+    CHECK(!more); // Finished well before the unseeked score would have reached its last note
+
+    cleanup_sequencer_state(seq);
+
+    // A text stream would parse up to the target on the audio thread, so only locate moves it
+    seq = create_streaming_sequencer("c4 d4 e4 f4", TEST_SAMPLE_RATE, 120, &c_major, &equal_temperament, 0, 0.5f);
+    CHECK(seq != NULL);
+    if (seq) {
+        CHECK(!sequencer_seek(seq, TEST_SAMPLE_RATE));
+        sequencer_locate(seq, TEST_SAMPLE_RATE);
+        CHECK(render_mono(seq, NULL, TEST_SAMPLE_RATE / 4) > 100.0);
+    }
+    cleanup_sequencer_state(seq);
+}
+
+// Notes resumed mid-note by a seek match a straight render to within 3 LSB: the envelopes are
+// fast-forwarded in closed form, so only the iterated truncation of the exponentials differs
+static void test_seek_resume_accuracy(void) {
+    // ADSR and pluck voices, held and released at the targets below
+    const char* score = "<c e g>2 [pluck square] c4 e4 [pluck sine] <d f a>2. [saw] c,1";
+    sequencer_state_t* straight = create_test_sequencer(score);
+    CHECK(straight != NULL);
+    if (!straight) {
+        return;
+    }
+    size_t length = straight->events.data[straight->events.count - 1].release_sample + TEST_SAMPLE_RATE;
+    int32_t* reference = calloc(length, sizeof(int32_t));
+    int32_t* resumed = calloc(length, sizeof(int32_t));
+    CHECK(reference && resumed);
+    if (reference && resumed) {
+        render_mono(straight, reference, length);
+
+        const uint32_t targets[] = {
+            TEST_SAMPLE_RATE / 2, // Chord sustaining
+            TEST_SAMPLE_RATE * 11 / 10, // Chord released, pluck sounding
+            TEST_SAMPLE_RATE * 5 / 2, // Mid chord with the pluck tails still decaying
+            TEST_SAMPLE_RATE * 9 / 2, // Saw sustaining
+        };
+        for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+            sequencer_state_t* seq = create_test_sequencer(score);
+            CHECK(seq != NULL);
+            if (!seq) {
+                continue;
+            }
+            sequencer_locate(seq, targets[t]);
+            size_t frames = length - targets[t];
+            render_mono(seq, resumed, frames);
+
+            int32_t max_error = 0;
+            for (size_t i = 0; i < frames; i++) {
+                int32_t error = abs(resumed[i] - reference[targets[t] + i]);
+                max_error = error > max_error ? error : max_error;
+            }
+            if (max_error > 3) {
+                fprintf(stderr, "seek to %u: max error %d LSB\n", targets[t], max_error);
+            }
+            CHECK(max_error <= 3);
+            cleanup_sequencer_state(seq);
+        }
+    }
+    free(reference);
+    free(resumed);
+    cleanup_sequencer_state(straight);
+}
+
+// ============================================================================
+// ADAPTIVE QUALITY
+// ============================================================================
+
+// Culling judges partials by what reaches the output, master volume included
+static void test_cull_follows_volume(void) {
+    const char* score = "[pluck square] c4";
+    sequencer_state_t* full = create_test_sequencer(score);
+    sequencer_state_t* quiet = create_test_sequencer(score);
+    CHECK(full && quiet);
+    if (full && quiet) {
+        sequencer_set_volume(quiet, 0.05f);
+        // Pinned at the deepest level: sequencer_render does not adapt it
+        full->cpu_budget = quiet->cpu_budget = Q16_ONE;
+        full->cull_level = quiet->cull_level = CULL_LEVEL_MAX;
+        render_mono(full, NULL, RENDER_BLOCK_SIZE);
+        render_mono(quiet, NULL, RENDER_BLOCK_SIZE);
+        CHECK(full->voices.num_active == 1 && quiet->voices.num_active == 1);
+        CHECK(full->voices.rendered_partials[0] == full->voices.num_partials[0]);
+        CHECK(quiet->voices.rendered_partials[0] < quiet->voices.num_partials[0]);
+        CHECK(quiet->voices.rendered_partials[0] > 0);
+    }
+    cleanup_sequencer_state(full);
+    cleanup_sequencer_state(quiet);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(void) {
+    music_init();
+
+    test_partial_tables_prewarmed();
+    test_phase_tables_concurrent();
+    test_partial_tables_concurrent();
+    test_parse_largest_value();
+    test_parse_error_position();
+    test_parse_unknown_instrument();
+    test_parse_recover();
+    test_parse_check();
+    test_track_merge();
+    test_track_merge_many();
+    test_stream_rejects_tracks();
+    test_live_note_on_off();
+    test_live_volume();
+    test_seek();
+    test_seek_resume_accuracy();
+    test_cull_follows_volume();
+
+    printf("%d checks, %d failed\n", checks_run, checks_failed);
+    return checks_failed ? 1 : 0;
+}